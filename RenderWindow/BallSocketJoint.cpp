@@ -4,16 +4,16 @@
 using namespace Math;
 using namespace Scene;
 
-void BallSocket::perturbParams(const float& scale) {
+void BallSocket::perturbParams(const float& scale, IKRandom& random) {
     float theta = _params[0];
     float phi = _params[1];
     float spin = _params[2];
 
     float dArc = scale*M_PI / 512;
-    float randPhi = 2 * M_PI*rand() / RAND_MAX;
-    spin += scale*((rand() < RAND_MAX / 2) ? M_PI : -M_PI) / 512;
+    float randPhi = std::uniform_real_distribution<float>(0, 2 * M_PI)(random);
+    spin += scale*(std::bernoulli_distribution()(random) ? M_PI : -M_PI) / 512;
 
-    glm::vec3 dAxis = glm::vec3(sin(dArc)*cos(randPhi), sin(dArc)*cos(randPhi), cos(dArc));
+    glm::vec3 dAxis = glm::vec3(sin(dArc)*cos(randPhi), sin(dArc)*sin(randPhi), cos(dArc));
 
     glm::mat3 R1 = matrixAlignZtoVEC(dAxis);
     glm::mat3 R = revertFromBasis(R1, Math::R(_wToJoint))*Math::R(_wToJoint);
@@ -62,6 +62,74 @@ void BallSocket::constrainParams() {
 }
 
 
+glm::quat BallSocket::rotationToJointFromParams(const float* params) const {
+    // Same rotation as buildTransformsFromParams() followed by rotationToJoint(), in closed form:
+    // ... spin about z, then tilt by theta about the horizontal axis perpendicular to phi (see AxisAngleRotation2),
+    // ... then the half turn about the local y-axis that flips the joint to face the socket
+    float theta = params[0];
+    float phi = params[1];
+    float spin = params[2];
+    glm::quat tilt(cos(theta / 2), -sin(theta / 2)*sin(phi), sin(theta / 2)*cos(phi), 0);
+    glm::quat twist(cos(spin / 2), 0, 0, sin(spin / 2));
+    glm::quat flip(0, 0, 1, 0);
+    return tilt*twist*flip;
+}
+
+namespace {
+    // The product tilt*twist*flip of BallSocket::rotationToJointFromParams, with tilt = (cos(theta/2),
+    // ... -sin(theta/2)sin(phi), sin(theta/2)cos(phi), 0) and twist = (cos(spin/2), 0, 0, sin(spin/2)), expanded so that
+    // ... each pose takes a handful of products once the sines and cosines are known
+    void ballRotations(const int n,
+        const float* __restrict sinHalfTheta, const float* __restrict cosHalfTheta,
+        const float* __restrict sinPhi, const float* __restrict cosPhi,
+        const float* __restrict sinHalfSpin, const float* __restrict cosHalfSpin,
+        float* __restrict qx, float* __restrict qy, float* __restrict qz, float* __restrict qw)
+    {
+        for (int p = 0; p < n; p++) {
+            float a = cosHalfTheta[p];
+            float b = -sinHalfTheta[p] * sinPhi[p];
+            float c = sinHalfTheta[p] * cosPhi[p];
+            float d = cosHalfSpin[p];
+            float e = sinHalfSpin[p];
+            qw[p] = b*e - c*d;
+            qx[p] = -a*e;
+            qy[p] = a*d;
+            qz[p] = b*d + c*e;
+        }
+    }
+}
+
+void BallSocket::rotationsToJointFromParams(const float* const* params, const int& n, Math::QuatBatch& q,
+    std::vector<float>& scratch) const
+{
+    scratch.resize(6 * n);
+    float* halfTheta = &scratch[0];
+    float* halfSpin = &scratch[4 * n];
+    for (int p = 0; p < n; p++) {
+        halfTheta[p] = params[0][p] / 2;
+        halfSpin[p] = params[2][p] / 2;
+    }
+    Math::sincos(halfTheta, &scratch[0], &scratch[n], n);
+    Math::sincos(params[1], &scratch[2 * n], &scratch[3 * n], n);
+    Math::sincos(halfSpin, &scratch[4 * n], &scratch[5 * n], n);
+    ballRotations(n, &scratch[0], &scratch[n], &scratch[2 * n], &scratch[3 * n], &scratch[4 * n], &scratch[5 * n],
+        q.x.data(), q.y.data(), q.z.data(), q.w.data());
+}
+
+bool BallSocket::rotationToJointDerivatives(std::map<int, glm::vec3>& omegas) const {
+    // With the rotation written as tilt(theta about v)*twist(spin about z)*flip, where v = Rz(phi)*y
+    // ... theta turns everything about v, spin about the tilted z-axis, and phi (turning v, and hence the tilt, about z)
+    // ... about z minus the tilted z-axis
+    float theta = _params.at(0);
+    float phi = _params.at(1);
+    glm::vec3 v(-sin(phi), cos(phi), 0);
+    glm::vec3 tiltedZ(sin(theta)*cos(phi), sin(theta)*sin(phi), cos(theta));
+    omegas[0] = v;
+    omegas[1] = glm::vec3(0, 0, 1) - tiltedZ;
+    omegas[2] = tiltedZ;
+    return true;
+}
+
 std::map<int, float> BallSocket::adjustableParams() const {
 
     if (_constraints.size() == 0) return _params;
@@ -25,7 +25,12 @@ namespace Scene {
         }
         void buildParamsFromTransforms();
         void constrainParams();
-        void perturbParams(const float& scale);
+        void perturbParams(const float& scale, IKRandom& random);
+
+        glm::quat rotationToJointFromParams(const float* params) const;
+        void rotationsToJointFromParams(const float* const* params, const int& n, Math::QuatBatch& q,
+            std::vector<float>& scratch) const;
+        bool rotationToJointDerivatives(std::map<int, glm::vec3>& omegas) const;
 
         void drawPivot(const float&) const;
 
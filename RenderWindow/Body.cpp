@@ -54,10 +54,13 @@ void Body::anchor(SkeletonComponent* component, const bool& tFixed, const bool&
         _anchoredRotations[component] = component->globalRotation();
     else
         _anchoredRotations.erase(component);
+
+    _stackedSystems.clear();
 }
 void Body::unanchor(SkeletonComponent* component) {
     _anchoredTranslations.erase(component);
     _anchoredRotations.erase(component);
+    _stackedSystems.clear();
     for (auto effector : _effectors)
         addEffector(effector.first);
 }
@@ -104,6 +107,18 @@ void Body::addEffector(SkeletonComponent* effector) {
     }
 
     _effectors[effector] = root->BFSdataSequence();
+    int nPaths = _effectors[effector].size();
+    _warmStarts[effector].clear();
+    for (int i = 0; i < nPaths; i++)
+        _warmStarts[effector].push_back(IKWarmStart(i + 1));  // every path perturbed its own way
+
+    // setTranslation solves the anchors' paths without their last component (see there)
+    _reaches[effector].clear();
+    for (int i = 0; i < nPaths; i++) {
+        ComponentPath path = _effectors[effector][i];
+        if (i > 0) path.pop_back();
+        _reaches[effector].push_back(pathReach(path));
+    }
 
     branchTree->suicide();
     effectorToAnchorsTree->suicide();
@@ -113,141 +128,91 @@ void Body::addEffector(SkeletonComponent* effector) {
 
 
 
-void Body::doDraw() {
-
-    if (_skeleton == NULL) return;
-    if (_skeleton->bones().size() == 0) return;
-
-    Bone* root = NULL;
-    std::set<SkeletonComponent*> anchors = this->anchors();
-    if (!anchors.empty()) {
-        SkeletonComponent* firstAnchor = *anchors.begin();
-        if (Connection* connection = dynamic_cast<Connection*>(firstAnchor)) {
-            if (connection->bone() != NULL) root = connection->bone();
-            else root = connection->opposingBone();
-        }
-        else root = dynamic_cast<Bone*>(firstAnchor);
-    }
-    else root = *_skeleton->bones().begin();
-
-
-    int nPush = 0;
-    int nPop = 0;
+int Body::solver(SkeletonComponent* effector) const {
+    auto it = _solvers.find(effector);
+    return (it == _solvers.end()) ? LINEAR_IK : it->second;
+}
 
-    vector<tuple<Bone*, Connection*, int>> stack;
-    stack.push_back(tuple<Bone*, Connection*, int>(root, NULL, 0));
-    set<Bone*> drawn;
-    vector<bool> depthVisited;
 
-    for (auto target : root->connectionToBones()) {
-        if (target.second != NULL) {
-            stack.push_back(make_tuple(target.second, target.first, 1));
-        }
-    }
 
-    vec3 translation;
-    vec3 rotation;
 
-    Bone* bone;
-    Connection* connection; // the halfJoint that connects bone to the Bone it descended from in the graph-theoretic sense
-    int depth;
-    int previousDepth = 0; // the depth of the root, which is the starting point
-    while (stack.size() > 0) {
 
-        tie(bone, connection, depth) = stack.back();
-        if (depthVisited.size() < depth + 1) {
-            depthVisited.resize(depth + 1, false);
-        }
-        depthVisited[depth] = true;
-        stack.pop_back();
+void Body::beginFrame() {
+    _lastFrameUpdateCounters = _updateCounters;
+    _updateCounters = UpdateCounters();
+}
 
-        if (depth == 2) {
-            int j = 0;
+void Body::doDraw() {
+    if (_skeleton == NULL) return;
+    SkeletonComponent* root = defaultRoot();
+    if (root == NULL) return;
+
+    // The global transforms are up to date, so the bones can be drawn straight from them in any order
+    // ... walking the cached flat skeleton (rather than searching the skeleton every frame) keeps the heap out of the frame loop
+    for (auto component : flatSkeleton(root).components()) {
+        Bone* bone = dynamic_cast<Bone*>(component);
+        if (bone == NULL) continue;
+
+        glPushMatrix();
+        pushTranslation(bone->globalTranslation());
+        pushRotation(bone->globalRotationMatrix());
+
+        glPushAttrib(GL_COLOR_MATERIAL);
+        if (_anchoredTranslations.find(bone) != _anchoredTranslations.end()
+            || _anchoredRotations.find(bone) != _anchoredRotations.end()) {
+            glMaterialfv(GL_FRONT, GL_DIFFUSE, red);
         }
-
-        for (auto target : bone->connectionToBones()) {
-            // the Bone from which "target" descended in the tree is just the variable "Bone* bone"
-            if (target.second != NULL && drawn.find(target.second) == drawn.end()) {
-                stack.push_back(make_tuple(target.second, target.first, depth + 1));
-            }
+        else if (_effectors.find(bone) != _effectors.end()) {
+            glMaterialfv(GL_FRONT, GL_DIFFUSE, green);
         }
-        if (true) {
-            glPushMatrix();
-            pushTranslation(bone->globalTranslation());
-            pushRotation(bone->globalRotation());
-
-            glPushAttrib(GL_COLOR_MATERIAL);
-            if (anchors.find(bone) != anchors.end()) {
-                glMaterialfv(GL_FRONT, GL_DIFFUSE, red);
-            }
-            else if (_effectors.find(bone) != _effectors.end()) {
-                glMaterialfv(GL_FRONT, GL_DIFFUSE, green);
-            }
-
-            bone->draw(0.2);
-
-            glPopAttrib();
 
-            glPopMatrix();
-        }
-        if (false) {
-            if (depth < previousDepth) {
-                for (int i = 0; i < previousDepth - depth; i++) {
-                    glPopMatrix();
-                    nPop++;
-                }
-                if (depthVisited[depth] && bone != root) {
-                    connection->transformAnchorToTarget(translation, rotation);
+        bone->draw(0.2);
 
-                    glPopMatrix();
-                    glPushMatrix();
-                    pushTranslation(translation);
-                    pushRotation(rotation);
-                }
-                bone->draw(0.2);
-            }
-            else {
-                if (depth == previousDepth) {
-                    glPopMatrix();
-                    nPop++;
-                }
-                connection->transformAnchorToTarget(translation, rotation);
-                glPushMatrix();
-                pushTranslation(translation);
-                pushRotation(rotation);
-                bone->draw(0.2);
-                nPush++;
-            }
-        }
-        drawn.insert(bone);
-        previousDepth = depth;
+        glPopAttrib();
 
+        glPopMatrix();
     }
     if (glGetError() != GL_NO_ERROR) {
         std::cout << gluErrorString(glGetError()) << std::endl;
     }
-    if (nPush != nPop) {
-        int j = 0;
-    }
 }
 
-void Body::hardUpdate(SkeletonComponent* rootIn) const {
-    SkeletonComponent* root = rootIn;
-    if (root == NULL) {
-        std::set<SkeletonComponent*> anchors = this->anchors();
-        if (anchors.size() == 0) {
-            root = *_skeleton->bones().begin();
-        }
-        else {
-            root = *anchors.begin();
+SkeletonComponent* Body::defaultRoot() const {
+    // Same as *anchors().begin() (the anchor with the lowest address), without building the set
+    SkeletonComponent* root = NULL;
+    if (!_anchoredTranslations.empty())
+        root = _anchoredTranslations.begin()->first;
+    if (!_anchoredRotations.empty() && (root == NULL || _anchoredRotations.begin()->first < root))
+        root = _anchoredRotations.begin()->first;
+    if (root == NULL)
+        root = _skeleton->firstBone();
+    return root;
+}
+
+FlatSkeleton& Body::flatSkeleton(SkeletonComponent* root) const {
+    int version = SkeletonComponent::topologyVersion();
+    auto it = _flatSkeletons.find(root);
+    if (it == _flatSkeletons.end() || it->second.first != version) {
+        for (auto flat = _flatSkeletons.begin(); flat != _flatSkeletons.end();) {
+            if (flat->second.first != version) flat = _flatSkeletons.erase(flat);
+            else flat++;
         }
+        it = _flatSkeletons.insert(std::make_pair(root, std::make_pair(version, FlatSkeleton()))).first;
+        it->second.second.compile(root);
     }
-    TreeNode<SkeletonComponent*>* updateTree = root->buildTreeTowards(root->connectedComponents());
-    updateGlobals(updateTree);
-    updateTree->suicide();
+    return it->second.second;
 }
 
-void Body::setTranslation(SkeletonComponent* effector, const glm::vec3& target) {
+void Body::hardUpdate(SkeletonComponent* rootIn) const {
+    SkeletonComponent* root = (rootIn == NULL) ? defaultRoot() : rootIn;
+    FlatSkeleton& flat = flatSkeleton(root);
+    if (_updatePool != NULL && flat.size() >= _minParallelSize)
+        flat.forwardKinematics(*_updatePool, _minParallelSize, &_updateCounters);
+    else
+        flat.updateGlobals(&_updateCounters);
+}
+
+void Body::setTranslation(SkeletonComponent* effector, const glm::vec3& target, const float& budget) {
     if (_anchoredTranslations.find(effector) != _anchoredTranslations.end()) return;
 
     if (_effectors.find(effector) == _effectors.end())
@@ -256,7 +221,27 @@ void Body::setTranslation(SkeletonComponent* effector, const glm::vec3& target)
     std::vector<ComponentPath> pathSeqn = _effectors[effector];
     int nPaths = pathSeqn.size();
 
-    linearSetIK(pathSeqn[0], target);
+    // The single-path solvers hold the anchor at the base of the first path fixed, but only close the other paths back onto
+    // ... it in translation, so an anchored rotation at the base of any other path is left to the stacked solve, which holds it
+    int solver = this->solver(effector);
+    bool stacked = solver == STACKED_IK || solver == SPARSE_LM_IK;
+    for (int i = 1; i < nPaths && !stacked; i++)
+        stacked = _anchoredRotations.find(pathSeqn[i].front()) != _anchoredRotations.end();
+    if (stacked) {
+        setTranslations(std::map<SkeletonComponent*, glm::vec3>({ { effector, target } }), budget);
+        return;
+    }
+
+    std::vector<IKWarmStart>& warmStarts = _warmStarts[effector];
+    const std::vector<IKReach>& reaches = _reaches[effector];
+
+    auto start = std::chrono::steady_clock::now();
+    IKDeadline deadline = (budget > 0) ? start + std::chrono::microseconds((long long)budget) : IKDeadline::max();
+    int passes = _updateCounters.passes;
+    IKSolveStats stats;
+    stats.budget = budget;
+
+    stats.converged = solveIK(solver, pathSeqn[0], target, &_updateCounters, &warmStarts[0], &stats, deadline, &reaches[0]);
 
     if (true) {
         for (int i = 1; i < nPaths; i++) {
@@ -264,12 +249,16 @@ void Body::setTranslation(SkeletonComponent* effector, const glm::vec3& target)
             std::vector<SkeletonComponent*> updatePath({ IKpath.back(), IKpath[IKpath.size() - 2] });
             IKpath.pop_back();
             IKpath.back()->backup();
-            updateGlobals(updatePath);
+            updateGlobals(updatePath, &_updateCounters);
             glm::vec3 t = IKpath.back()->globalTranslation();
             IKpath.back()->restore();
-            linearSetIK(IKpath, t);
+            bool converged = solveIK(solver, IKpath, t, &_updateCounters, &warmStarts[i], &stats, deadline, &reaches[i]);
+            stats.converged = stats.converged && converged;
         }
     }
+
+    stats.residual = glm::length(target - effector->globalTranslation());
+    recordSolve(std::set<SkeletonComponent*>({ effector }), stats, start, passes);
     if (false) {
         auto backupAll = [&]() {
             for (auto componentPath : pathSeqn) {
@@ -340,4 +329,210 @@ void Body::setTranslation(SkeletonComponent* effector, const glm::vec3& target)
             }
         }
     }
+}
+
+void Body::setTranslations(const std::map<SkeletonComponent*, glm::vec3>& targets, const float& budget) {
+    std::map<SkeletonComponent*, IKTarget> tipTargets;
+    for (auto target : targets)
+        tipTargets[target.first] = IKTarget(target.second);
+    solveStacked(tipTargets, budget);
+}
+
+void Body::setTransform(SkeletonComponent* effector, const glm::vec3& t, const glm::vec3& w, const float& rotationWeight,
+    const float& budget)
+{
+    solveStacked(std::map<SkeletonComponent*, IKTarget>({ { effector, IKTarget(t, Math::q(w), 1, rotationWeight) } }), budget);
+}
+
+void Body::solveStacked(const std::map<SkeletonComponent*, IKTarget>& targets, const float& budget) {
+    std::set<SkeletonComponent*> effectors;
+    for (auto target : targets) {
+        if (_anchoredTranslations.find(target.first) != _anchoredTranslations.end()) continue;
+        if (_effectors.find(target.first) == _effectors.end())
+            addEffector(target.first);
+        effectors.insert(target.first);
+    }
+    if (effectors.empty()) return;
+
+    // the rows of the system come in the same order as its paths (see stackedSystem)
+    // ... and each anchor only pins down the parts of its transform that were anchored
+    SkeletonComponent* root = defaultRoot();
+    std::vector<IKTarget> tipTargets;
+    for (auto effector : effectors)
+        tipTargets.push_back(targets.at(effector));
+    for (auto anchor : anchors()) {
+        if (anchor == root) continue;
+        auto t = _anchoredTranslations.find(anchor);
+        auto w = _anchoredRotations.find(anchor);
+        bool tFixed = t != _anchoredTranslations.end();
+        bool wFixed = w != _anchoredRotations.end();
+        tipTargets.push_back(IKTarget(tFixed ? t->second : anchor->globalTranslation(),
+            wFixed ? Math::q(w->second) : anchor->globalQuaternion(), tFixed ? 1.0f : 0.0f, wFixed ? 1.0f : 0.0f));
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    IKDeadline deadline = (budget > 0) ? start + std::chrono::microseconds((long long)budget) : IKDeadline::max();
+    int passes = _updateCounters.passes;
+    IKSolveStats stats;
+    stats.budget = budget;
+
+    // dense DLS unless one of the effectors asks for the sparse solve
+    bool sparse = false;
+    for (auto effector : effectors)
+        sparse = sparse || solver(effector) == SPARSE_LM_IK;
+    if (sparse) stats.converged = lmSetIK(stackedSystem(effectors), tipTargets, &_updateCounters, &stats, deadline);
+    else stats.converged = dlsSetIK(stackedSystem(effectors), tipTargets, &_updateCounters, &stats, deadline);
+
+    for (auto effector : effectors)
+        stats.residual = fmax(stats.residual, glm::length(targets.at(effector).translation - effector->globalTranslation()));
+    recordSolve(effectors, stats, start, passes);
+}
+
+void Body::recordSolve(const std::set<SkeletonComponent*>& effectors, IKSolveStats& stats,
+    const std::chrono::steady_clock::time_point& start, const int& passes)
+{
+    stats.fkEvaluations = _updateCounters.passes - passes;
+    stats.microseconds = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count();
+
+    for (auto effector : effectors)
+        _lastSolveStats[effector] = stats;
+
+    if (_solveHistoryWindow <= 0) return;
+    _solveHistory.push_back(stats);
+    while ((int)_solveHistory.size() > _solveHistoryWindow)
+        _solveHistory.pop_front();
+}
+
+IKSolveStats Body::lastSolveStats(SkeletonComponent* effector) const {
+    auto it = _lastSolveStats.find(effector);
+    return (it == _lastSolveStats.end()) ? IKSolveStats() : it->second;
+}
+
+void Body::setSolveHistory(const int& window) {
+    _solveHistoryWindow = window;
+    while ((int)_solveHistory.size() > std::max(window, 0))
+        _solveHistory.pop_front();
+}
+
+IKSolveAggregate Body::solveAggregate() const {
+    IKSolveAggregate aggregate;
+    for (auto& stats : _solveHistory) {
+        aggregate.solves++;
+        if (!stats.converged) aggregate.failures++;
+        if (stats.perturbed) aggregate.perturbations++;
+        aggregate.iterations += stats.iterations;
+        aggregate.fkEvaluations += stats.fkEvaluations;
+        aggregate.rejectedSteps += stats.rejectedSteps;
+        if (stats.outOfTime) aggregate.outOfTime++;
+        aggregate.worstResidual = fmax(aggregate.worstResidual, stats.residual);
+        aggregate.microseconds += stats.microseconds;
+        aggregate.worstMicroseconds = fmax(aggregate.worstMicroseconds, stats.microseconds);
+        aggregate.budget += stats.budget;
+    }
+    return aggregate;
+}
+
+IKSystem& Body::stackedSystem(const std::set<SkeletonComponent*>& effectors) {
+    int version = SkeletonComponent::topologyVersion();
+    auto it = _stackedSystems.find(effectors);
+    if (it != _stackedSystems.end() && it->second.first == version)
+        return it->second.second;
+
+    // Everything hangs off the root, which stays put: one path to each effector, then one to each other anchor
+    // ... whose tip is pulled back onto where (and how) it was anchored
+    SkeletonComponent* root = defaultRoot();
+    std::vector<SkeletonComponent*> tips(effectors.begin(), effectors.end());
+    for (auto anchor : anchors())
+        if (anchor != root) tips.push_back(anchor);
+
+    std::set<SkeletonComponent*> targets(tips.begin(), tips.end());
+    TreeNode<SkeletonComponent*>* tree = root->buildTreeToTargets(targets);
+    std::map<SkeletonComponent*, ComponentPath> pathsToTargets;
+    for (auto node : tree->DFSsequence()) {
+        if (targets.find(node->data()) == targets.end() || pathsToTargets.find(node->data()) != pathsToTargets.end())
+            continue;
+        ComponentPath path;
+        for (TreeNode<SkeletonComponent*>* ancestor = node; ancestor != NULL; ancestor = ancestor->parent())
+            path.push_back(ancestor->data());
+        std::reverse(path.begin(), path.end());
+        pathsToTargets[node->data()] = path;
+    }
+    tree->suicide();
+
+    std::vector<ComponentPath> paths;
+    for (auto tip : tips) {
+        auto path = pathsToTargets.find(tip);
+        paths.push_back((path == pathsToTargets.end()) ? ComponentPath({ tip }) : path->second);
+    }
+
+    _stackedSystems[effectors] = std::make_pair(version, buildSystem(paths));
+    return _stackedSystems[effectors].second;
+}
+
+
+void Scene::solveBatch(std::vector<IKRequest>& requests, ThreadPool& pool) {
+    // The bodies in the order they first show up
+    std::unordered_map<Body*, int> bodyIndices;
+    std::vector<Body*> bodies;
+    for (auto& request : requests) {
+        if (bodyIndices.insert(std::make_pair(request.body, (int)bodies.size())).second)
+            bodies.push_back(request.body);
+    }
+
+    // Bodies over overlapping bones would race in updateGlobals, backup and restore, so they are merged into one task
+    // ... (union-find over the bodies, joining every body with the first one found owning each of its bones)
+    int nBodies = bodies.size();
+    std::vector<int> merged(nBodies);
+    for (int i = 0; i < nBodies; i++)
+        merged[i] = i;
+    auto find = [&](int i) {
+        while (merged[i] != i) i = merged[i] = merged[merged[i]];
+        return i;
+    };
+    std::unordered_map<Bone*, int> owners;
+    for (int i = 0; i < nBodies; i++) {
+        if (bodies[i]->skeleton() == NULL) continue;
+        for (auto bone : bodies[i]->skeleton()->bones()) {
+            auto owner = owners.insert(std::make_pair(bone, i));
+            if (!owner.second) merged[find(i)] = find(owner.first->second);
+        }
+    }
+
+    // One list of requests per task, in the order given
+    std::vector<int> taskIndices(nBodies, -1);
+    std::vector<std::vector<IKRequest*>> taskRequests;
+    for (auto& request : requests) {
+        int root = find(bodyIndices[request.body]);
+        if (taskIndices[root] < 0) {
+            taskIndices[root] = taskRequests.size();
+            taskRequests.push_back(std::vector<IKRequest*>());
+        }
+        taskRequests[taskIndices[root]].push_back(&request);
+    }
+
+    // The tasks share the bones' poses, backups and stashes with no copy of their own, so this only holds up while the merge
+    // ... leaves every bone to exactly one task
+#ifndef NDEBUG
+    std::unordered_map<Bone*, int> boneTasks;
+    for (int i = 0; i < nBodies; i++) {
+        if (bodies[i]->skeleton() == NULL) continue;
+        int task = taskIndices[find(i)];
+        for (auto bone : bodies[i]->skeleton()->bones()) {
+            auto entry = boneTasks.insert(std::make_pair(bone, task));
+            assert(entry.first->second == task);
+        }
+    }
+#endif
+
+    TaskGroup group;
+    for (auto& list : taskRequests) {
+        std::vector<IKRequest*>* taskList = &list;
+        pool.submit(group, [taskList]() {
+            for (auto request : *taskList) {
+                request->body->setTranslation(request->effector, request->translation, request->budget);
+                request->stats = request->body->lastSolveStats(request->effector);
+            }
+        });
+    }
+    pool.wait(group);
 }
\ No newline at end of file
@@ -3,6 +3,9 @@
 
 #include "Scene.h"
 #include "BodyComponents.h"
+#include "IKSolvers.h"
+#include "ThreadPool.h"
+#include "FlatSkeleton.h"
 
 namespace Scene {
 
@@ -13,6 +16,23 @@ namespace Scene {
 
     typedef std::vector<SkeletonComponent*> ComponentPath;
 
+    // Totals over the solves a body keeps (see Body::setSolveHistory)
+    struct IKSolveAggregate {
+        IKSolveAggregate() : solves(0), failures(0), perturbations(0), iterations(0), fkEvaluations(0), rejectedSteps(0), outOfTime(0),
+            worstResidual(0), microseconds(0), worstMicroseconds(0), budget(0) {}
+        int solves;
+        int failures;           // solves that did not converge
+        int perturbations;      // solves that ended up perturbing the couplings
+        int iterations;
+        int fkEvaluations;
+        int rejectedSteps;
+        int outOfTime;          // solves cut short by their budget
+        float worstResidual;
+        float microseconds;     // total wall time
+        float worstMicroseconds;
+        float budget;           // total budget of the solves that had one
+    };
+
     class Body : public Object
     {
     public:
@@ -24,28 +44,111 @@ namespace Scene {
         void unanchor(SkeletonComponent*);
 
         void addEffector(SkeletonComponent*);
+        // Picks the IK solver (one of the *_IK constants in IKSolvers.h) used to move the given effector, LINEAR_IK by default
+        // ... the single-path solvers can't hold an anchored rotation off the effector's base, so setTranslation stacks those
+        void setSolver(SkeletonComponent* effector, const int& solver) { _solvers[effector] = solver; }
+        int solver(SkeletonComponent* effector) const;
 
         std::set<SkeletonComponent*> anchors() const;
 
         Skeleton* skeleton() const { return _skeleton; }
 
+        // Brings the global transforms up to date from the root's (the default root is picked from the anchors)
+        // ... incrementally on the calling thread, or all of them across the update pool if the body has one
         void hardUpdate(SkeletonComponent* root = NULL) const;
+        // Has hardUpdate recompute the skeletons of at least minParallelSize components in parallel on the pool (a full pass,
+        // ... which only pays off for large skeletons that mostly move as a whole). NULL, the default, keeps it incremental
+        void setUpdatePool(ThreadPool* pool, const int& minParallelSize = 256) {
+            _updatePool = pool;
+            _minParallelSize = minParallelSize;
+        }
         void jiggle(const float& magnitude = 1) { _skeleton->jiggle(magnitude); hardUpdate(); }
 
-        void setTranslation(SkeletonComponent* component, const glm::vec3& t);
+        // budget is the wall time the solve may take in microseconds (0 for no limit), past which the best pose found so far stays
+        // ... the anchors' paths are solved within the same budget, so a tight one may leave them to the next call
+        void setTranslation(SkeletonComponent* component, const glm::vec3& t, const float& budget = 0);
+        // Moves every given effector onto its target in one solve, holding every anchor in place at the same time
+        // ... (effectors whose solver is STACKED_IK or SPARSE_LM_IK, or whose paths reach an anchored rotation other than
+        // ... the first path's base, go through here from setTranslation too)
+        void setTranslations(const std::map<SkeletonComponent*, glm::vec3>& targets, const float& budget = 0);
+        // Moves the effector onto t and turns it to the global axis-angle rotation w, in the same stacked solve as setTranslations
+        // rotationWeight trades radians of orientation error against units of distance (0 leaves the orientation free)
+        void setTransform(SkeletonComponent* effector, const glm::vec3& t, const glm::vec3& w, const float& rotationWeight = 1,
+            const float& budget = 0);
+
+        // What the last setTranslation (or setTranslations, setTransform) moving the effector took, over all the paths solved
+        // ... microseconds / budget is the share of its budget the effector used, for a scheduler to rebalance on
+        IKSolveStats lastSolveStats(SkeletonComponent* effector) const;
+        // Keeps the stats of the body's last window solves for solveAggregate (0, the default, keeps none)
+        void setSolveHistory(const int& window);
+        IKSolveAggregate solveAggregate() const;
+
+        // Work done by updateGlobals since the current frame began, and during the last complete frame
+        UpdateCounters updateCounters() const { return _updateCounters; }
+        UpdateCounters lastFrameUpdateCounters() const { return _lastFrameUpdateCounters; }
+        // To be called once at the start of every frame (before the frame's solves): the counters so far become the last frame's
+        void beginFrame();
 
         void doDraw();
     private:
+        SkeletonComponent* defaultRoot() const;
+        FlatSkeleton& flatSkeleton(SkeletonComponent* root) const;
+        IKSystem& stackedSystem(const std::set<SkeletonComponent*>& effectors);
+        void solveStacked(const std::map<SkeletonComponent*, IKTarget>& targets, const float& budget);
+        // Completes the stats of a solve that started at start, with _updateCounters.passes at passes, and files them
+        void recordSolve(const std::set<SkeletonComponent*>& effectors, IKSolveStats& stats,
+            const std::chrono::steady_clock::time_point& start, const int& passes);
+
         std::map<SkeletonComponent*, glm::vec3> _anchoredTranslations;
         std::map<SkeletonComponent*, glm::vec3> _anchoredRotations;
         Skeleton* _skeleton;
 
         std::map<SkeletonComponent*, std::vector<ComponentPath>> _effectors;
+        std::map<SkeletonComponent*, int> _solvers;
+        // linearSetIK state carried over from one setTranslation to the next, one per path of the effector (reset by addEffector)
+        std::map<SkeletonComponent*, std::vector<IKWarmStart>> _warmStarts;
+        // Reach of each path of the effector as solved by setTranslation, from the constraints as they were in addEffector
+        std::map<SkeletonComponent*, std::vector<IKReach>> _reaches;
+
+        // hardUpdate traversals compiled with their rigid local transforms, keyed on their root
+        // ... valid for as long as the topology version they were built at
+        // Each tells what changed from the stamps it saw itself, so updating through one never leaves another stale
+        mutable std::map<SkeletonComponent*, std::pair<int, FlatSkeleton>> _flatSkeletons;
+        // Systems for setTranslations, keyed on their effectors, valid until the anchors change or the topology version moves on
+        std::map<std::set<SkeletonComponent*>, std::pair<int, IKSystem>> _stackedSystems;
+
+        std::map<SkeletonComponent*, IKSolveStats> _lastSolveStats;
+        std::deque<IKSolveStats> _solveHistory;
+        int _solveHistoryWindow = 0;
+
+        mutable UpdateCounters _updateCounters;
+        UpdateCounters _lastFrameUpdateCounters;
+
+        ThreadPool* _updatePool = NULL;
+        int _minParallelSize = 256;
 
         const glm::vec3 _t = glm::vec3(0, 0, 0);
         const glm::vec3 _w = glm::vec3(0, 0, 0);
     };
 
+    // One effector target of a batch (see solveBatch)
+    struct IKRequest {
+        IKRequest(Body* b = NULL, SkeletonComponent* e = NULL, const glm::vec3& t = glm::vec3(0, 0, 0), const float& microseconds = 0) :
+            body(b), effector(e), translation(t), budget(microseconds) {}
+        Body* body;
+        SkeletonComponent* effector;
+        glm::vec3 translation;
+        float budget;           // for setTranslation, in microseconds (0 for no limit)
+        IKSolveStats stats;     // filled in by solveBatch: the effector's lastSolveStats once its request is done
+    };
+
+    // Runs body->setTranslation for every request, spread over the pool's workers
+    // The requests of one body all move the same pose (and go through its warm starts, caches and stats), so they run
+    // ... on a single task in the order given. So do the requests of bodies whose skeletons share bones, which would
+    // ... otherwise race on them. Every other body gets a task of its own, run in parallel with the rest
+    // Nothing may couple, decouple, attach or detach components while the batch runs
+    void solveBatch(std::vector<IKRequest>& requests, ThreadPool& pool);
+
 }
 
 #endif
\ No newline at end of file
@@ -1,4 +1,5 @@
 #include "BodyComponents.h"
+#include "Matrix.h"
 
 using namespace Scene;
 using namespace std;
@@ -18,89 +19,114 @@ void Scene::restoreSkeletonComponents(std::vector<SkeletonComponent*> components
 }
 
 
-void Scene::updateGlobals(TreeNode<SkeletonComponent*>* componentTree) {
-    std::vector<TreeNode<SkeletonComponent*>*> seqn = componentTree->DFSsequence();
-
-    SkeletonComponent* root = seqn[0]->data();
-    TransformStack transformStack(root->globalTranslation(), root->globalRotation());
-
-    for (int i = 1; i < seqn.size(); i++) {
-        SkeletonComponent* component = seqn[i]->data();
+void Scene::updateGlobals(const std::vector<SkeletonComponent*>& components, UpdateCounters* counters) {
+    Scene::updateGlobals(components, 0, components.size() - 1, counters);
+}
 
-        int depth = seqn[i]->depth();
-        int previousDepth = seqn[i - 1]->depth();
+void Scene::updateGlobals(const std::vector<SkeletonComponent*>& components, const int& first, const int& last, UpdateCounters* counters) {
+    // Runs once per IK step, so nothing in here touches the heap: the running transform lives on the stack
+    // ... and the edges are read straight off the components
 
-        if (depth < previousDepth) {
-            transformStack.pop();
-        }
-        else if (depth == previousDepth) {
-            std::cout << std::endl; // this should never happen
-        }
-        else {
-            glm::vec3 t, w;
-            SkeletonComponent* previousComponent = seqn[i - 1]->data();
-            std::tie(t, w) = previousComponent->transformsToConnectedComponents()[component];
-            
-            transformStack.push();
-            transformStack.translate(t);
-            transformStack.rotate(w);
+    RigidTransform global = components[first]->globalTransform();
 
-            component->setGlobalTranslation(transformStack.getTranslation());
-            component->setGlobalRotation(transformStack.getRotation());
+    auto isFinite = [](const RigidTransform& transform) {
+        glm::vec3 t = transform.translation();
+        glm::quat q = transform.quaternion();
+        return isfinite(t[0]) && isfinite(t[1]) && isfinite(t[2])
+            && isfinite(q.x) && isfinite(q.y) && isfinite(q.z) && isfinite(q.w);
+    };
 
-        }
-    }
-}
+    if (counters != NULL) counters->passes++;
 
-void Scene::updateGlobals(const std::vector<SkeletonComponent*>& components) {
+    glm::vec3 t, w;
+    for (int i = first + 1; i <= last; i++) {
+        SkeletonComponent* component = components[i];
+        SkeletonComponent* previousComponent = components[i - 1];
 
-    SkeletonComponent* root = components[0];
-    TransformStack transformStack(root->globalTranslation(), root->globalRotation());
+        if (!previousComponent->transformToConnectedComponent(component, t, w)) return;
 
-    glm::vec3 t, w;
+        global = global*RigidTransform(t, w);
+        if (!isFinite(global)) return; // leave the rest of the path as it was rather than spreading NaNs down it
 
-    auto warn = [&]() {
-        auto reupdate = [&]() {
-            transformStack.pop();
-            transformStack.push();
-            transformStack.translate(t);
-            transformStack.rotate(w);
-        };
-        glm::vec3 trans = transformStack.getTranslation();
-        glm::vec3 rot = transformStack.getRotation();
-        if (!isfinite(trans[0]) || !isfinite(trans[1]) || !isfinite(trans[2])) {
-            reupdate();
-        }
-        if (!isfinite(rot[0]) || !isfinite(rot[1]) || !isfinite(rot[2])) {
-            reupdate();
+        if (counters != NULL) {
+            counters->visited++;
+            counters->recomputed++;
         }
-    };
 
-    warn();
+        component->setGlobalTransform(global);
+    }
+}
 
-    for (int i = 1; i < components.size(); i++) {
-        SkeletonComponent* component = components[i];
-        SkeletonComponent* previousComponent = components[i - 1];
-        auto transformsToConnectedComponents = previousComponent->transformsToConnectedComponents();
-        auto it = transformsToConnectedComponents.find(component);
 
-        if (it == transformsToConnectedComponents.end()) return;
+bool Scene::pastDeadline(const IKDeadline& deadline, IKSolveStats* stats) {
+    if (deadline == IKDeadline::max() || std::chrono::steady_clock::now() < deadline) return false;
+    if (stats != NULL) stats->outOfTime = true;
+    return true;
+}
 
-        std::tie(t, w) = it->second;
+glm::vec3 IKReach::clamp(const glm::vec3& target) const {
+    if (pivot == NULL) return target;
+    glm::vec3 center = pivot->globalTranslation();
+    glm::vec3 offset = target - center;
+    float distance = glm::length(offset);
+    if (distance > maximum)
+        return center + (maximum / distance)*offset;
+    if (distance < minimum && distance > 0)
+        return center + (minimum / distance)*offset;
+    return target;
+}
 
-        transformStack.translate(t);
-        transformStack.rotate(w);
+IKReach Scene::pathReach(const std::vector<SkeletonComponent*>& armBaseToTip) {
+    IKReach reach;
+    int n = armBaseToTip.size();
+
+    // Positions along the path relative to its base (whatever the globals are at the moment)
+    std::vector<glm::vec3> positions(n);
+    RigidTransform global;
+    for (int i = 1; i < n; i++) {
+        glm::vec3 t, w;
+        if (!armBaseToTip[i - 1]->transformToConnectedComponent(armBaseToTip[i], t, w)) return reach;
+        global = global*RigidTransform(t, w);
+        positions[i] = global.translation();
+    }
 
-        warn();
+    // The lengths of the stretches that move rigidly, from the first coupling that can move on
+    // A coupling turns about its joint (the socket's offset to it is fixed in the socket's frame)
+    // ... so the stretches meet at the joints, and the offset belongs to the stretch on the socket's side
+    std::vector<float> lengths;
+    int stretchStart = -1;
+    for (int i = 0; i < n - 1; i++) {
+        Connection* connection = dynamic_cast<Connection*>(armBaseToTip[i]);
+        if (connection == NULL || connection->opposingConnection() != armBaseToTip[i + 1]) continue;
+        Socket* socket;
+        Joint* joint;
+        std::tie(socket, joint) = connection->socketJoint();
+        if (socket->adjustableParams().empty()) continue;
+
+        int pivot = (connection == socket) ? i + 1 : i;
+        if (stretchStart < 0) reach.pivot = joint;
+        else lengths.push_back(glm::length(positions[pivot] - positions[stretchStart]));
+        stretchStart = pivot;
+    }
+    if (stretchStart < 0) {
+        // nothing moves, so the tip can only stay where it is
+        reach.pivot = armBaseToTip.back();
+        return reach;
+    }
+    lengths.push_back(glm::length(positions[n - 1] - positions[stretchStart]));
 
-        component->setGlobalTranslation(transformStack.getTranslation());
-        component->setGlobalRotation(transformStack.getRotation());
+    float longest = 0;
+    for (auto length : lengths) {
+        reach.maximum += length;
+        longest = fmax(longest, length);
     }
+    reach.minimum = fmax(0.0f, 2 * longest - reach.maximum);
+    return reach;
 }
 
-
-bool Scene::linearSetIK(const std::vector<SkeletonComponent*>& armBaseToTip, const glm::vec3& tipTarget) {
-
+bool Scene::linearSetIK(const std::vector<SkeletonComponent*>& armBaseToTip, const glm::vec3& requestedTarget, UpdateCounters* counters,
+    IKWarmStart* warmStart, IKSolveStats* stats, const IKDeadline& deadline, const IKReach* reach)
+{
     SkeletonComponent* tip = armBaseToTip.back();
 
     auto backupAll = [&]() {
@@ -127,43 +153,162 @@ bool Scene::linearSetIK(const std::vector<SkeletonComponent*>& armBaseToTip, con
         }
     }
 
+    // Out of reach, the best the tip can do is the nearest point within reach, which it goes for instead
+    // ... rather than spending every try (and a perturbation) on a target it cannot get to
+    glm::vec3 tipTarget = (reach != NULL) ? reach->clamp(requestedTarget) : requestedTarget;
+    if (stats != NULL && tipTarget != requestedTarget) stats->clamped = true;
+
     glm::vec3 tipPosition = tip->globalTranslation();
     glm::vec3 stepToTarget = tipTarget - tipPosition;
     float distanceToTarget = glm::length(stepToTarget);
 
+    // How far the tip moves per unit step handed to nudge: every socket turns by J^T step, so the tip moves by J J^T step
+    auto nudgeResponse = [&]() {
+        glm::mat3 response(0);
+        for (auto forwardConnection : forwardConnections) {
+            // nudge always goes through the socket of the coupling
+            Connection* socketSide = forwardConnection;
+            bool directionToTip = DOWNSTREAM;
+            if (dynamic_cast<Socket*>(socketSide) == NULL) {
+                socketSide = forwardConnection->opposingConnection();
+                directionToTip = UPSTREAM;
+            }
+            glm::mat3 J;
+            std::tie(J, std::ignore) = socketSide->J(tip, directionToTip);
+            response += J*glm::transpose(J);
+        }
+        return response;
+    };
+
+    // A warm start only holds for corrections the size of what the last solve left over (nothing has moved since)
+    // ... anything else starts cold, from the exact response at the current pose and at full scale
+    bool warm = warmStart != NULL && warmStart->valid
+        && distanceToTarget <= 8 * fmax(glm::length(warmStart->residual), 0.01f);
+    glm::mat3 response = warm ? warmStart->response : nudgeResponse();
+    float scale = warm ? warmStart->stepScale : 1;
+
+    // The step that the response estimate expects to carry the tip onto the target, damped like dampedLeastSquaresStep
+    // ... so that a near singular chain cannot send the tip flying
+    auto preconditioned = [&](const glm::vec3& stepToTarget) {
+        const float damping = 0.5f;
+        return glm::inverse(response + glm::mat3(damping*damping))*stepToTarget;
+    };
+
+    // Step control: a step is only kept if it achieves a fraction (armijo) of the decrease its slope promises
+    // ... and the scale acts as a trust region, growing when the response estimate predicted the decrease well
+    // ... and shrinking when it did not. A rejected step is cut back to the minimum of the quadratic through the current cost
+    // ... its predicted slope and its actual cost, rather than blindly halved
+    const float armijo = 1e-4f;
+    float cost = distanceToTarget*distanceToTarget;
+
+    bool exactResponse = !warm;
     bool success = false;
     int maxTries = 64;
     int tries = 0;
+    bool outOfTime = false;
     while (distanceToTarget > 0.01f && tries < maxTries) {
+        outOfTime = pastDeadline(deadline, stats);
+        if (outOfTime) break;
+
+        glm::vec3 step = scale*preconditioned(stepToTarget);
+        glm::vec3 predictedMove = response*step;
+        glm::vec3 predictedStepToTarget = stepToTarget - predictedMove;
+        float slope = -2 * glm::dot(stepToTarget, predictedMove);      // d(cost)/d(fraction of the step) at 0
+        float predictedDecrease = cost - glm::dot(predictedStepToTarget, predictedStepToTarget);
+        if (!(slope < 0) || !(predictedDecrease > 0)) {
+            // the estimate sees no way down along this step, which an exact one may well find
+            if (exactResponse) break;
+            response = nudgeResponse();
+            exactResponse = true;
+            continue;
+        }
+        exactResponse = false;
+        if (stats != NULL) stats->iterations++;
 
         for (auto forwardConnection : forwardConnections) {
-            forwardConnection->nudge(tip, stepToTarget, DOWNSTREAM);
+            forwardConnection->nudge(tip, step, DOWNSTREAM);
         }
-        Scene::updateGlobals(armBaseToTip);
+        Scene::updateGlobals(armBaseToTip, counters);
 
         glm::vec3 newTipPosition = tip->globalTranslation();
         glm::vec3 newStepToTarget = tipTarget - newTipPosition;
         float newDistanceToTarget = glm::length(newStepToTarget);
+        float newCost = newDistanceToTarget*newDistanceToTarget;
 
-        if (newDistanceToTarget < distanceToTarget) {
+        // Broyden update: whether or not the step is kept, it tells how the tip actually responded to it
+        // ... which keeps the estimate current without going back to the Jacobians
+        float stepSquared = glm::dot(step, step);
+        if (stepSquared > 1e-12f)
+            response += glm::outerProduct(((newTipPosition - tipPosition) - response*step) / stepSquared, step);
+
+        float actualDecrease = cost - newCost;
+        if (actualDecrease > 0 && actualDecrease >= -armijo*slope) {
             backupAll();
             distanceToTarget = newDistanceToTarget;
+            cost = newCost;
             tipPosition = newTipPosition;
             stepToTarget = newStepToTarget;
+            float agreement = actualDecrease / predictedDecrease;
+            if (agreement > 0.75f) scale = fmin(1.0f, 2 * scale);
+            else if (agreement < 0.25f) scale /= 2;
             tries = 0;
             success = true;
         }
         else {
             restoreAll();
-            stepToTarget /= 2;
+            if (stats != NULL) stats->rejectedSteps++;
+            float cut = -slope / (2 * (newCost - cost - slope));
+            scale *= fmin(0.5f, fmax(0.1f, cut));
             tries++;
         }
     }
-    if (!success) for (auto forwardConnection : forwardConnections) {
-        forwardConnection->perturbCoupling();
-        Scene::updateGlobals(armBaseToTip);
+    if (!success && !outOfTime && distanceToTarget > 0.01f) {
+        // No step got the tip any closer: typically the chain is stretched towards (or folded away from) the target
+        // ... so that its only way to the target is across the line to it. Push the tip sideways, in the direction across
+        // ... that line in which it moves most easily (the top eigenvector of the exact response with that line projected out)
+        // ... which turns the couplings out of the singular pose the same way every time
+        // Only a chain that cannot move across that line at all falls back to a random perturbation
+        glm::vec3 along = stepToTarget / distanceToTarget;
+        glm::mat3 across = glm::mat3(1) - glm::outerProduct(along, along);
+        response = nudgeResponse();
+        glm::mat3 acrossResponse = across*response*across;
+
+        Math::Matrix A(3, 3), V;
+        std::vector<float> values;
+        for (int i = 0; i < 3; i++)
+            for (int j = 0; j < 3; j++)
+                A(i, j) = acrossResponse[j][i];
+        Math::symmetricEigen(A, values, V);
+        int top = std::max_element(values.begin(), values.end()) - values.begin();
+
+        if (values[top] > 1e-6f) {
+            glm::vec3 sideways(V(0, top), V(1, top), V(2, top));
+            glm::vec3 step = preconditioned(0.25f*distanceToTarget*glm::normalize(sideways));
+            for (auto forwardConnection : forwardConnections) {
+                forwardConnection->nudge(tip, step, DOWNSTREAM);
+            }
+        }
+        else {
+            IKRandom fallback;
+            IKRandom& random = warmStart != NULL ? warmStart->random : fallback;
+            for (auto forwardConnection : forwardConnections) {
+                forwardConnection->perturbCoupling(1, &random);
+            }
+        }
+        Scene::updateGlobals(armBaseToTip, counters);
+        if (stats != NULL) stats->perturbed = true;
+    }
+
+    if (warmStart != NULL) {
+        // A failed solve leaves nothing worth starting from (the couplings may even have just been perturbed)
+        // ... but one that ran out of time was still making progress, which the next call can pick up from
+        bool valid = distanceToTarget <= 0.01f || outOfTime;
+        warmStart->valid = valid;
+        warmStart->response = valid ? response : glm::mat3(1);
+        warmStart->stepScale = valid ? fmax(scale, 1.0f / 64) : 1;
+        warmStart->residual = tipTarget - tip->globalTranslation();
     }
-    return distanceToTarget < 0.01f;
+    return glm::length(requestedTarget - tip->globalTranslation()) < 0.01f;
 }
 
 
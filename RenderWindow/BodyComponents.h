@@ -6,9 +6,10 @@
 #include "GlutDraw.h"
 #include "utils.h"
 #include "Math.h"
+#include "MathBatch.h"
 #include "TreeNode.h"
 #include "TreeNode.cpp"
-#include "TransformStack.h"
+#include "RigidTransform.h"
 
 enum {
     PIN = 0,
@@ -32,11 +33,93 @@ namespace Scene {
     class Skeleton;
     class SkeletonComponent;
 
+    // Tallies of the work done by updateGlobals, accumulated until somebody resets them (e.g. once per frame)
+    struct UpdateCounters {
+        UpdateCounters() : passes(0), visited(0), recomputed(0) {}
+        int passes;         // calls to updateGlobals
+        int visited;        // components traversed
+        int recomputed;     // components whose global transform was actually rebuilt
+    };
+
+    // What IK solves took, added up by the solvers that are handed one (Body completes it per effector, see Body::lastSolveStats)
+    struct IKSolveStats {
+        IKSolveStats() : iterations(0), fkEvaluations(0), rejectedSteps(0), perturbed(false), converged(false), residual(0), microseconds(0),
+            budget(0), outOfTime(false), clamped(false) {}
+        int iterations;         // steps tried (sweeps for CCD, passes for FABRIK)
+        int fkEvaluations;      // updateGlobals passes
+        int rejectedSteps;      // steps undone by restoring the backups
+        bool perturbed;         // the solve got nowhere, and moved the couplings off their pose to escape it
+        bool converged;
+        float residual;         // distance from the effector to its target at the end
+        float microseconds;     // wall time
+        float budget;           // wall time the solve was given, in microseconds (0 for no limit)
+        bool outOfTime;         // the solve was cut short by its deadline, and kept the best pose it had found by then
+        bool clamped;           // the target was out of reach (see IKReach), so the solve went for the nearest point within reach
+    };
+
+    // Wall-clock deadline for the IK solvers, which stop once it has passed, keeping the best pose found so far
+    typedef std::chrono::steady_clock::time_point IKDeadline;
+    // Whether the deadline has passed (noting it in the stats if so)
+    bool pastDeadline(const IKDeadline&, IKSolveStats* = NULL);
+
+    // Randomness for the IK solvers, which draw from an engine of their own (seeded per path) rather than from rand()
+    // ... so that a failed solve replays identically
+    typedef std::minstd_rand IKRandom;
+
+    // What one linearSetIK solve of a path leaves behind for the next, which (e.g. frame to frame) starts next to where it ended
+    struct IKWarmStart {
+        IKWarmStart(const unsigned int& seed = IKRandom::default_seed) : valid(false), stepScale(1), residual(0, 0, 0), response(1), random(seed) {}
+        bool valid;             // false until a solve has succeeded, and again after one has failed
+        float stepScale;        // scale of the last accepted step, relative to the full step to the target
+        glm::vec3 residual;     // from the tip to the target at the end of the last solve
+        glm::mat3 response;     // estimate of how far the tip moves per unit step handed to nudge (i.e. of J J^T)
+        IKRandom random;        // for the perturbation of a chain that cannot move towards the target at all
+    };
+
+    // How far the tip of a path can get from the joint of the first coupling met along it (which stays put while the path is solved)
+    // Targets out of [minimum, maximum] from there cannot be reached, whatever the couplings do
+    struct IKReach {
+        IKReach() : pivot(NULL), minimum(0), maximum(0) {}
+        SkeletonComponent* pivot;   // the joint of the path's first coupling (NULL for no bounds)
+        float minimum;
+        float maximum;
+
+        // The point within reach nearest to the target (the target itself if there are no bounds, or if it is within reach)
+        // The pivot's global transform is assumed to be up to date
+        glm::vec3 clamp(const glm::vec3& target) const;
+    };
+
+    // Bounds from the lengths of the path's rigid stretches from one coupling's joint to the next (bones with their
+    // ... connections' offsets, including the sockets' offsets to their joints, see Socket::reach)
+    // Of the joint limits, only those that lock a coupling in place are taken into account (the coupling is then part
+    // ... of a rigid stretch): cone limits are not, so the maximum may be more than the path can actually reach
+    IKReach pathReach(const std::vector<SkeletonComponent*>& armBaseToTip);
+
+    // A traversal of the components reachable from a root, flattened to pre-order (what FlatSkeleton is compiled from)
+    struct UpdatePlan {
+        std::vector<SkeletonComponent*> components;    // components[0] is the root
+        std::vector<int> parents;                      // index of each component's parent in components (-1 for the root)
+    };
+
     // The following updates global transformations assuming that the "root of input" is fixed (and doens't need to be updated)
-    void updateGlobals(TreeNode<SkeletonComponent*>*);
-    void updateGlobals(const std::vector<SkeletonComponent*>&);
+    // It always recomputes the whole path (the branches off the path are left stale, for the next Body::hardUpdate)
+    // Whole skeletons are updated incrementally by FlatSkeleton::updateGlobals (see Body::hardUpdate)
+    void updateGlobals(const std::vector<SkeletonComponent*>&, UpdateCounters* = NULL);
+    // Same as the path version, restricted to the stretch of the path from components[first] (fixed) to components[last]
+    void updateGlobals(const std::vector<SkeletonComponent*>&, const int& first, const int& last, UpdateCounters* = NULL);
     // The following sets the last SkeletonComponent to the target destination
-    bool linearSetIK(const std::vector<SkeletonComponent*>& armBaseToTip, const glm::vec3& tipTarget);
+    // The nudges are preconditioned by an estimate of how the tip responds to them (J J^T, kept up to date from every trial step)
+    // ... which also predicts the decrease of each step: a step is kept on sufficient (Armijo) decrease, and the step scale
+    // ... grows or shrinks like a trust region depending on how well the decrease was predicted
+    // Given a warm start, that estimate and the last accepted step scale carry over from the previous solve of the path
+    // ... so that tracking a slowly moving target only takes a step or two
+    // If no step gets the tip any closer, the couplings are nudged so that the tip moves sideways off the line to the target
+    // ... (random perturbations, from the warm start's engine, are left for chains that cannot move across it at all)
+    // Past the deadline, it returns with the best pose found so far (and without perturbing the couplings)
+    // Given the path's reach, a target out of it is clamped to the nearest point within it, which the tip goes for instead
+    // ... (so once the tip is there, solving for the same target again returns at once). It still returns false
+    bool linearSetIK(const std::vector<SkeletonComponent*>& armBaseToTip, const glm::vec3& tipTarget, UpdateCounters* = NULL,
+        IKWarmStart* = NULL, IKSolveStats* = NULL, const IKDeadline& = IKDeadline::max(), const IKReach* = NULL);
     void linearNudgeIK(const std::vector<SkeletonComponent*>& armBaseToTip, const glm::vec3& tipNudge);
     void backupSkeletonComponents(std::vector<SkeletonComponent*>);
     void restoreSkeletonComponents(std::vector<SkeletonComponent*>);
@@ -44,14 +127,45 @@ namespace Scene {
     class SkeletonComponent // Wrapper class for Bones and Connections (Sockets and Joints)
     {
     public:
-        SkeletonComponent() : _tGlobal(glm::vec3(0, 0, 0)), _wGlobal(glm::vec3(0, 0, 0)) {}
-        SkeletonComponent(const glm::vec3& t, const glm::vec3& w) : _tGlobal(t), _wGlobal(w) {}
-
-        glm::vec3 globalTranslation() const { return _tGlobal; }
-        glm::vec3 globalRotation() const { return _wGlobal; }
+        SkeletonComponent() : _global(RigidTransform()), _wGlobal(glm::vec3(0, 0, 0)), _wGlobalValid(true), _stamp(0) {}
+        SkeletonComponent(const glm::vec3& t, const glm::vec3& w) : _global(RigidTransform(t, w)), _wGlobal(w), _wGlobalValid(true), _stamp(0) {}
+
+        glm::vec3 globalTranslation() const { return _global.translation(); }
+        glm::vec3 globalRotation() const {
+            if (!_wGlobalValid) {
+                _wGlobal = _global.rotation();
+                _wGlobalValid = true;
+            }
+            return _wGlobal;
+        }
+        glm::mat3 globalRotationMatrix() const { return _global.rotationMatrix(); }
+        glm::quat globalQuaternion() const { return _global.quaternion(); }
+        RigidTransform globalTransform() const { return _global; }
+
+        void setGlobalTranslation(const glm::vec3& tGlobal) { _global.setTranslation(tGlobal); markDirty(); }
+        void setGlobalRotation(const glm::vec3& wGlobal) {
+            _global.setRotation(wGlobal);
+            _wGlobal = wGlobal;
+            _wGlobalValid = true;
+            markDirty();
+        }
+        void setGlobalRotation(const glm::quat& qGlobal) {
+            _global.setRotation(qGlobal);
+            _wGlobalValid = false;
+            markDirty();
+        }
+        // Unlike the setters above, this one does not mark the component dirty, since it is what the updates write with
+        void setGlobalTransform(const RigidTransform& global) {
+            _global = global;
+            _wGlobalValid = false;
+        }
 
-        void setGlobalTranslation(const glm::vec3& tGlobal) { _tGlobal = tGlobal; }
-        void setGlobalRotation(const glm::vec3& wGlobal) { _wGlobal = wGlobal; }
+        // Marks the component dirty when its own transforms change (its local transforms, or its global transform set
+        // ... directly), so that everything downstream of it is stale, by bumping its stamp (restore bumps it too)
+        // The stamp is never reset: each cache keeps the stamp it last saw and compares (see FlatSkeleton::updateGlobals)
+        // ... so that no traversal can mark a component clean on behalf of another
+        void markDirty() { _stamp++; }
+        unsigned int stamp() const { return _stamp; }
 
         void localUpdateGlobalTranslation(const glm::vec3&);
         void localUpdateGlobalRotation(const glm::vec3&);
@@ -60,28 +174,46 @@ namespace Scene {
         std::set<SkeletonComponent*> connectedComponents() const;
         TreeNode<SkeletonComponent*>* buildTreeToTargets(std::set<SkeletonComponent*>);
         TreeNode<SkeletonComponent*>* buildTreeTowards(std::set<SkeletonComponent*>);
+        UpdatePlan buildUpdatePlan();
+
+        // Bumped by every couple/decouple/attach/detach, so that cached traversals (see UpdatePlan) can tell they went stale
+        static int topologyVersion() { return _topologyVersion; }
+        static void touchTopology() { _topologyVersion++; }
 
         std::map<SkeletonComponent*, std::pair<glm::vec3, glm::vec3>> transformsToConnectedComponents() const;
+        // Same as looking up a single entry of the map above, without building the map (no heap allocations)
+        // Returns false if the argument isn't connected to this component
+        bool transformToConnectedComponent(SkeletonComponent*, glm::vec3& t, glm::vec3& w) const;
 
         void backup() {
-            _tGlobal_stashed = _tGlobal;
+            _global_stashed = _global;
             _wGlobal_stashed = _wGlobal;
+            _wGlobalValid_stashed = _wGlobalValid;
             backupLocals();
         }
         void restore() {
-            _tGlobal = _tGlobal_stashed;
+            _global = _global_stashed;
             _wGlobal = _wGlobal_stashed;
+            _wGlobalValid = _wGlobalValid_stashed;
+            _stamp++;
             restoreLocals();
         }
         virtual void backupLocals() {}
         virtual void restoreLocals() {}
 
     protected:
-        glm::vec3 _tGlobal;
-        glm::vec3 _wGlobal;
-
-        glm::vec3 _tGlobal_stashed;
+        // The global transform is stored with its rotation matrix cached (see RigidTransform)
+        // The axis-angle view _wGlobal is only rebuilt from it when somebody asks for globalRotation()
+        RigidTransform _global;
+        mutable glm::vec3 _wGlobal;
+        mutable bool _wGlobalValid;
+        unsigned int _stamp;
+
+        RigidTransform _global_stashed;
         glm::vec3 _wGlobal_stashed;
+        bool _wGlobalValid_stashed;
+
+        static int _topologyVersion;
     };
 
     
@@ -156,7 +288,8 @@ namespace Scene {
 
         TreeNode<Bone*>* boneTree();
 
-        void perturbCoupling(const float& scale = 1);
+        // Turns the coupling by a random amount, drawn from the given engine (or from one shared by the thread if NULL)
+        void perturbCoupling(const float& scale = 1, IKRandom* = NULL);
 
 
         /////////////////
@@ -182,9 +315,14 @@ namespace Scene {
         glm::vec3 translationToBone() const { return Math::rotate(-_tFromBone, -_wFromBone); }
         glm::vec3 rotationToBone() const { return -_wFromBone; }
 
+        // Derivatives of the tip's global translation (first) and the tip's global angular velocity (second)
+        // ... with respect to each adjustable parameter of the socket-joint coupling (one column per parameter, in key order)
         std::pair<glm::mat3, glm::mat3> J(SkeletonComponent* tip, const bool& tipDirection);
         //std::pair<arma::mat, arma::mat> J(SkeletonComponent* tip, const bool& tipDirection);
         void nudge(SkeletonComponent* tip, const glm::vec3& step, const bool& tipDirection);
+        // Turns the tip side of the coupling about the joint's origin by the given global rotation (as far as the socket's constraints allow)
+        // The globals of the coupling's connections must be up to date, and are left stale
+        void turnCoupling(const glm::quat& dq, const bool& tipDirection);
 
         virtual void backupLink() {};
         virtual void restoreLink() {};
@@ -202,8 +340,8 @@ namespace Scene {
         //// SETTERS ////
         /////////////////
 
-        void setTranslationFromBone(const glm::vec3& translation) { _tFromBone = translation; }
-        void setRotationFromBone(const glm::vec3& w) { _wFromBone = Math::clampRotation(w); }
+        void setTranslationFromBone(const glm::vec3& translation) { _tFromBone = translation; markDirty(); }
+        void setRotationFromBone(const glm::vec3& w) { _wFromBone = Math::clampRotation(w); markDirty(); }
 
         Bone* attach(Bone* bone);
         void dettach();
@@ -283,7 +421,23 @@ namespace Scene {
             _wToJoint_stashed = _wToJoint;
         }
 
-        virtual float reach() const { return 0; }
+        // How far the joint sits from the socket: a fixed offset in the socket's frame, with the coupling turning about the joint
+        // ... so it is part of the rigid stretch on the socket's side (which is how pathReach counts it)
+        virtual float reach() const { return glm::length(_tToJoint); }
+
+        // The rotation to the joint (see rotationToJoint) that the given parameters (in key order) would produce
+        // ... without touching the socket, so that many poses can be evaluated at once (see PoseBatch)
+        // The parameters are taken as they are, i.e. no constraints are applied
+        virtual glm::quat rotationToJointFromParams(const float* params) const { return Math::q(rotationToJoint()); }
+        // Same for n parameter sets at once into q[0, n), parameter j of set p being params[j][p] (the layout of PoseBatch)
+        // ... scratch is working space, grown as needed, so that a caller that keeps it around never allocates
+        // The default converts one set at a time, sockets with a closed form convert them all with the kernels of MathBatch.h
+        virtual void rotationsToJointFromParams(const float* const* params, const int& n, Math::QuatBatch& q,
+            std::vector<float>& scratch) const;
+        // Angular velocity (in the frame of the socket) of the joint per unit change of each parameter, keyed like params()
+        // ... i.e. d(R_toJoint)/d(param) = [omega]x * R_toJoint
+        // Returns false if the socket has no closed form, in which case Connection::J falls back to finite differences
+        virtual bool rotationToJointDerivatives(std::map<int, glm::vec3>& omegas) const { return false; }
 
         /////////////////
         //// GETTERS ////
@@ -295,9 +449,9 @@ namespace Scene {
 
         glm::vec3 translationToJoint() const { return _tToJoint; }
         glm::vec3 rotationToJoint() const {
-            glm::mat3 R0 = Math::R(_wToJoint);
-            glm::mat3 R1 = Math::R(R0*glm::vec3(0, M_PI, 0));
-            return Math::w(R1*R0);
+            // R(_wToJoint) followed by a half turn about its own y axis, i.e. R(R0*(0, pi, 0))*R0 = R0*R(0, pi, 0)
+            // ... composed as quaternions, since the result is often close to a half turn, where Math::w(mat3) loses precision
+            return Math::w(Math::q(_wToJoint)*glm::quat(0, 0, 1, 0));
         }
         glm::vec3 translationFromJoint() const { return Math::rotate(-_tToJoint, -rotationToJoint()); }
         glm::vec3 rotationFromJoint() const { return -rotationToJoint(); }
@@ -320,7 +474,7 @@ namespace Scene {
         //// DANGEROUS FUNCTIONS THAT SHOULD NOT BE ACCESSED PUBLICLY ////
         //////////////////////////////////////////////////////////////////
 
-        virtual void perturbParams(const float& scale) {}
+        virtual void perturbParams(const float& scale, IKRandom&) {}
         virtual void buildTransformsFromParams() {}
         virtual void buildParamsFromTransforms() {}
 
@@ -358,6 +512,7 @@ namespace Scene {
 
         std::set<std::pair<Socket*, Joint*>> socketJoints() const;
         std::set<Bone*> bones() const { return _bones; }
+        Bone* firstBone() const { return _bones.empty() ? NULL : *_bones.begin(); }
         std::set<Socket*> sockets() const;
         std::set<Joint*> joints() const;
         std::vector<SkeletonComponent*> getAllComponents() const;
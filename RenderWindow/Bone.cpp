@@ -115,6 +115,8 @@ Joint* Bone::attach(Joint* joint) {
     }
     _joints.insert(joint);
     joint->_bone = this;
+    joint->markDirty();
+    touchTopology();
     return joint;
 }
 void Bone::detach(Joint* joint) {
@@ -123,6 +125,7 @@ void Bone::detach(Joint* joint) {
     if (it != _joints.end()) {
         _joints.erase(it);
         joint->_bone = NULL;
+        touchTopology();
         Bone* target = joint->opposingBone();
         if (target != NULL) {
             set<Bone*> reachableBones_fromDetached = target->reachableBones();
@@ -156,6 +159,8 @@ Socket* Bone::attach(Socket* socket) {
     }
     _sockets.insert(socket);
     socket->_bone = this;
+    socket->markDirty();
+    touchTopology();
     return socket;
 }
 void Bone::detach(Socket* socket) {
@@ -164,6 +169,7 @@ void Bone::detach(Socket* socket) {
     if (it != _sockets.end()) {
         _sockets.erase(it);
         socket->_bone = NULL;
+        touchTopology();
         Bone* target = socket->opposingBone();
         if (target != NULL) {
             set<Bone*> reachableBones_fromDetached = target->reachableBones();
@@ -229,12 +235,14 @@ bool Bone::hasConnection(Connection* connection) const {
 void Bone::draw(const float& scale) const {
     doDraw();
 
-    for (auto connection : connections()) {
+    auto drawConnection = [](Connection* connection) {
         Connection* opposingConnection = connection->opposingConnection();
         float d0 = glm::length(connection->translationFromBone());
         float d1 = glm::length(opposingConnection->translationFromBone());
         connection->draw(fmin(d0, d1) / 8);
-    }
+    };
+    for (auto socket : _sockets) drawConnection(socket);
+    for (auto joint : _joints) drawConnection(joint);
 }
 
 void Bone::doDraw(const float& scale) const {
@@ -251,12 +259,13 @@ void Bone::doDraw(const float& scale) const {
 
     float fatness = 8.0f;
     if (_sockets.size() + _joints.size() < 3) {
-        vector<glm::vec3> pts;
+        glm::vec3 pts[2];
+        int nPts = 0;
         for (auto socket : _sockets)
-            pts.push_back(socket->_tFromBone);
+            pts[nPts++] = socket->_tFromBone;
         for (auto joint : _joints)
-            pts.push_back(joint->_tFromBone);
-        if (pts.size() == 1) {
+            pts[nPts++] = joint->_tFromBone;
+        if (nPts == 1) {
             GlutDraw::drawPyramid(glm::vec3(0, 0, 0), pts[0], glm::vec3(0, 1, 0)*glm::length(pts[0]) / fatness);
         }
         else {
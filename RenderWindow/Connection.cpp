@@ -172,7 +172,7 @@ bool Connection::alignToConnection(Connection* target, glm::vec3& t, glm::vec3&
             lastConnection->translationToOpposingConnection(),
             lastConnection->rotationToOpposingConnection()));
     }
-    auto tw = Math::composeLocalTransforms(localTransforms).back();
+    auto tw = Math::composeAllLocalTransforms(localTransforms);
     t = tw.first;
     w = tw.second;
     return true;
@@ -368,11 +368,32 @@ std::pair<glm::mat3, glm::mat3> Connection::J(SkeletonComponent* tip, const bool
         glm::mat3 dt_dparam;
         glm::mat3 dw_dparam;
 
-        float dParam = 1.0f / 1024;
+        Connection* joint = opposingConnection();
 
-        glm::vec3 tPlus, tMinus, wPlus, wMinus;
+        std::map<int, glm::vec3> omegas;
+        if (socket->rotationToJointDerivatives(omegas)) {
+            // The coupling is a pure rotation about the joint's origin, so each parameter swings everything on the tip side
+            // ... rigidly about that point with angular velocity omega (taken to the global frame through the socket,
+            // ... and reversed when the socket itself is on the tip side)
+            glm::mat3 R_root2socket = socket->globalRotationMatrix();
+            float sign = (directionToTip == DOWNSTREAM) ? 1.0f : -1.0f;
+            glm::vec3 pivotToTip = tip->globalTranslation() - joint->globalTranslation();
+
+            int column = 0;
+            for (auto param : adjustableParams) {
+                if (column == 3) break;
+                glm::vec3 Omega = sign*(R_root2socket*omegas[param.first]);
+                dt_dparam[column] = glm::cross(Omega, pivotToTip);
+                dw_dparam[column] = Omega;
+                column++;
+            }
+            return std::make_pair(dt_dparam, dw_dparam);
+        }
 
-        Connection* joint = opposingConnection();
+        float dParam = 1.0f / 1024;
+
+        glm::vec3 tPlus, tMinus;
+        glm::mat3 RPlus, RMinus;
 
         Connection* rootsideConnection = NULL;
         Connection* tipsideConnection = NULL;
@@ -385,11 +406,9 @@ std::pair<glm::mat3, glm::mat3> Connection::J(SkeletonComponent* tip, const bool
             tipsideConnection = socket;
         }
         glm::mat3 R_root2rootsideConnection
-            = Math::R(rootsideConnection->globalRotation());
+            = rootsideConnection->globalRotationMatrix();
         glm::mat3 R_root2tipsideConnection // This one will change
             = Math::R(R_root2rootsideConnection*rootsideConnection->rotationToOpposingConnection())*R_root2rootsideConnection;
-        glm::mat3 R_tipsideConnection2tip
-            = Math::R(tip->globalRotation())*Math::R(-tipsideConnection->globalRotation());
         glm::vec3 t_tipsideConnection2tip_tipSideConnectionFrame
             = glm::inverse(R_root2tipsideConnection)*(tip->globalTranslation() - tipsideConnection->globalTranslation());
 
@@ -403,7 +422,7 @@ std::pair<glm::mat3, glm::mat3> Connection::J(SkeletonComponent* tip, const bool
             tPlus
                 = R_root2rootsideConnection*rootsideConnection->translationToOpposingConnection()
                 + R_root2tipsideConnection*t_tipsideConnection2tip_tipSideConnectionFrame;
-            wPlus = Math::w(R_tipsideConnection2tip*R_root2tipsideConnection);
+            RPlus = R_root2tipsideConnection;
             socket->restore();
 
             socket->_params[param.first] -= dParam;
@@ -413,11 +432,11 @@ std::pair<glm::mat3, glm::mat3> Connection::J(SkeletonComponent* tip, const bool
             tMinus
                 = R_root2rootsideConnection*rootsideConnection->translationToOpposingConnection()
                 + R_root2tipsideConnection*t_tipsideConnection2tip_tipSideConnectionFrame;
-            wMinus = Math::w(R_tipsideConnection2tip*R_root2tipsideConnection);
+            RMinus = R_root2tipsideConnection;
             socket->restore();
 
-            glm::vec3 Dt = (tPlus - tMinus) / dParam;
-            glm::vec3 Dw = (wPlus - wMinus) / dParam;
+            glm::vec3 Dt = (tPlus - tMinus) / (2 * dParam);
+            glm::vec3 Dw = Math::w(Math::q(RPlus*glm::transpose(RMinus))) / (2 * dParam); // the tip turns rigidly with the tip-side connection
 
             dt_dparam[column][0] = Dt[0];
             dt_dparam[column][1] = Dt[1];
@@ -431,7 +450,7 @@ std::pair<glm::mat3, glm::mat3> Connection::J(SkeletonComponent* tip, const bool
         return std::make_pair(dt_dparam, dw_dparam);
     }
     else if (Joint* joint = dynamic_cast<Joint*>(this)) {
-        return J(opposingConnection(), !directionToTip);
+        return opposingConnection()->J(tip, !directionToTip);
     }
 }
 
@@ -460,15 +479,39 @@ void Connection::nudge(SkeletonComponent* tip, const glm::vec3& step, const bool
     }
 }
 
-void Connection::perturbCoupling(const float& scale) {
+void Connection::turnCoupling(const glm::quat& dq, const bool& directionToTip) {
+    Connection* opposingConnection = this->opposingConnection();
+    if (opposingConnection == NULL) return;
+
+    if (Socket* socket = dynamic_cast<Socket*>(this)) {
+        // Re-expressed in the socket's frame, the turn pre-multiplies the rotation to the joint
+        // ... (inverted when the socket itself is on the tip side, since then it is the socket that turns against the joint)
+        glm::quat qSocket = socket->globalQuaternion();
+        glm::quat dqLocal = glm::conjugate(qSocket)*((directionToTip == DOWNSTREAM) ? dq : glm::conjugate(dq))*qSocket;
+        glm::quat qToJoint = dqLocal*Math::q(socket->rotationToJoint());
+        // rotationToJoint() is R(_wToJoint) followed by a half turn about y, so take that back off
+        socket->setRotationToJoint(Math::w(glm::normalize(qToJoint*glm::quat(0, 0, 1, 0))));
+    }
+    else if (Joint* joint = dynamic_cast<Joint*>(this)) {
+        opposingConnection->turnCoupling(dq, !directionToTip);
+    }
+}
+
+void Connection::perturbCoupling(const float& scale, IKRandom* random) {
     if (opposingBone() == NULL) return;
 
+    if (random == NULL) {
+        thread_local IKRandom shared;
+        random = &shared;
+    }
+
     if (Socket* socket = dynamic_cast<Socket*>(this)) {
-        socket->perturbParams(scale);
+        socket->perturbParams(scale, *random);
         socket->constrainParams();
         socket->buildTransformsFromParams();
+        socket->markDirty();
     }
     else if (Joint* joint = dynamic_cast<Joint*>(this)) {
-        joint->socket()->perturbCoupling(scale);
+        joint->socket()->perturbCoupling(scale, random);
     }
 }
\ No newline at end of file
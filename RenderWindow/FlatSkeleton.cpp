@@ -0,0 +1,204 @@
+#include "FlatSkeleton.h"
+
+using namespace Scene;
+
+void FlatSkeleton::compile(SkeletonComponent* root) {
+    compile(root == NULL ? UpdatePlan() : root->buildUpdatePlan());
+}
+
+void FlatSkeleton::compile(const UpdatePlan& plan) {
+    _components.clear();
+    _parents.clear();
+    _edgeTypes.clear();
+    _subtreeSizes.clear();
+    _childCounts.clear();
+    _locals.clear();
+    _stamps.clear();
+    _indices.clear();
+    _couplings.clear();
+    _sockets.clear();
+    _maxDepth = 0;
+    int n = plan.components.size();
+    if (n == 0) return;
+
+    // The plan's traversal is already in pre-order, with every parent before its children
+    std::vector<int> depths;
+    for (int i = 0; i < n; i++) {
+        SkeletonComponent* component = plan.components[i];
+        int parent = plan.parents[i];
+        _components.push_back(component);
+        _parents.push_back(parent);
+        _indices[component] = i;
+
+        if (parent < 0) {
+            _edgeTypes.push_back(ROOT);
+            _locals.push_back(RigidTransform());
+            depths.push_back(0);
+        }
+        else {
+            SkeletonComponent* parentComponent = _components[parent];
+            Connection* from = dynamic_cast<Connection*>(parentComponent);
+            if (from != NULL && from->opposingConnection() == component) {
+                _edgeTypes.push_back(COUPLING);
+                _locals.push_back(RigidTransform());
+                _couplings.push_back(i);
+                _sockets.push_back(from->socketJoint().first);
+            }
+            else {
+                _edgeTypes.push_back(RIGID);
+                _locals.push_back(rigidTransform(i));
+            }
+            depths.push_back(depths[parent] + 1);
+            _maxDepth = std::max(_maxDepth, depths.back());
+        }
+    }
+
+    // Pre-order keeps every subtree contiguous, so sizes accumulate in a single backward pass
+    _subtreeSizes.assign(n, 1);
+    _childCounts.assign(n, 0);
+    for (int i = n - 1; i > 0; i--) {
+        _subtreeSizes[_parents[i]] += _subtreeSizes[i];
+        _childCounts[_parents[i]]++;
+    }
+
+    // Seen as changed by the first update, which then re-reads every edge
+    _stamps.resize(n);
+    for (int i = 0; i < n; i++)
+        _stamps[i] = _components[i]->stamp() - 1;
+
+    _globals.resize(n);
+    refreshCouplings();
+    gatherParams();
+}
+
+int FlatSkeleton::index(SkeletonComponent* component) const {
+    auto it = _indices.find(component);
+    if (it == _indices.end()) return -1;
+    else return it->second;
+}
+
+RigidTransform FlatSkeleton::rigidTransform(const int& i) const {
+    glm::vec3 t, w;
+    _components[_parents[i]]->transformToConnectedComponent(_components[i], t, w);
+    return RigidTransform(t, w);
+}
+
+RigidTransform FlatSkeleton::couplingTransform(const int& i) const {
+    Connection* from = dynamic_cast<Connection*>(_components[_parents[i]]);
+    return RigidTransform(from->translationToOpposingConnection(), from->rotationToOpposingConnection());
+}
+
+void FlatSkeleton::refreshCouplings() {
+    for (auto i : _couplings)
+        _locals[i] = couplingTransform(i);
+}
+
+void FlatSkeleton::refreshLocals() {
+    int n = _components.size();
+    _changed.resize(n);
+    for (int i = 0; i < n; i++) {
+        // a component changed when its own transforms did since this skeleton last went through it (whoever else
+        // ... went through it in between), and an edge is made of the transforms of both its ends
+        SkeletonComponent* component = _components[i];
+        _changed[i] = component->stamp() != _stamps[i];
+        _stamps[i] = component->stamp();
+        if (i > 0 && (_changed[i] || _changed[_parents[i]]))
+            _locals[i] = (_edgeTypes[i] == COUPLING) ? couplingTransform(i) : rigidTransform(i);
+    }
+}
+
+void FlatSkeleton::forwardKinematics(UpdateCounters* counters) {
+    int n = _components.size();
+    if (n == 0) return;
+    refreshLocals();
+    _globals[0] = _components[0]->globalTransform();
+    forwardKinematicsSubtree(0, NULL, NULL, 0);
+
+    if (counters != NULL) {
+        counters->passes++;
+        counters->visited += n;
+        counters->recomputed += n - 1;
+    }
+}
+
+void FlatSkeleton::updateGlobals(UpdateCounters* counters) {
+    int n = _components.size();
+    if (n == 0) return;
+    refreshLocals();
+    _moved.resize(n);
+    _moved[0] = _changed[0];
+
+    int recomputed = 0;
+    for (int i = 1; i < n; i++) {
+        _moved[i] = _moved[_parents[i]] || _changed[i];
+        if (_moved[i]) {
+            _components[i]->setGlobalTransform(_components[_parents[i]]->globalTransform()*_locals[i]);
+            recomputed++;
+        }
+    }
+
+    if (counters != NULL) {
+        counters->passes++;
+        counters->visited += n;
+        counters->recomputed += recomputed;
+    }
+}
+
+void FlatSkeleton::forwardKinematics(ThreadPool& pool, const int& minParallelSize, UpdateCounters* counters) {
+    int n = _components.size();
+    if (n == 0) return;
+    refreshLocals();
+    _globals[0] = _components[0]->globalTransform();
+    TaskGroup group;
+    forwardKinematicsSubtree(0, &pool, &group, minParallelSize);
+    pool.wait(group);
+
+    if (counters != NULL) {
+        counters->passes++;
+        counters->visited += n;
+        counters->recomputed += n - 1;
+    }
+}
+
+void FlatSkeleton::forwardKinematicsSubtree(const int& root, ThreadPool* pool, TaskGroup* group, const int& minParallelSize) {
+    // Assumes _globals[root] is up to date
+    int end = root + _subtreeSizes[root];
+    int i = root + 1;
+    while (i < end) {
+        _globals[i] = _globals[_parents[i]] * _locals[i];
+        _components[i]->setGlobalTransform(_globals[i]);
+
+        // Only split at forks: handing off the single child of a chain would just move the work to another thread
+        if (pool != NULL && _subtreeSizes[i] >= minParallelSize && _childCounts[_parents[i]] > 1) {
+            int subtreeRoot = i;
+            pool->submit(*group, [this, subtreeRoot, pool, group, minParallelSize]() {
+                forwardKinematicsSubtree(subtreeRoot, pool, group, minParallelSize);
+            });
+            i += _subtreeSizes[i];
+        }
+        else i++;
+    }
+}
+
+void FlatSkeleton::gatherParams() {
+    _paramOffsets.assign(1, 0);
+    _paramKeys.clear();
+    _params.clear();
+    for (auto socket : _sockets) {
+        for (auto param : socket->params()) {
+            _paramKeys.push_back(param.first);
+            _params.push_back(param.second);
+        }
+        _paramOffsets.push_back(_params.size());
+    }
+}
+
+void FlatSkeleton::scatterParams() const {
+    int nSockets = _sockets.size();
+    for (int k = 0; k < nSockets; k++) {
+        std::map<int, float> params;
+        for (int j = _paramOffsets[k]; j < _paramOffsets[k + 1]; j++)
+            params[_paramKeys[j]] = _params[j];
+        _sockets[k]->setParams(params);
+    }
+}
\ No newline at end of file
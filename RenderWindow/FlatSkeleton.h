@@ -0,0 +1,111 @@
+#ifndef _FLATSKELETON_H_
+#define _FLATSKELETON_H_
+
+#include "stdafx.h"
+#include "BodyComponents.h"
+#include "RigidTransform.h"
+#include "ThreadPool.h"
+
+namespace Scene {
+
+    // A Skeleton "compiled" into flat arrays for forward kinematics
+    // ... components are stored in DFS pre-order starting from the root, so every parent precedes its children
+    // ... and the global transforms can be recomputed with a single linear pass (no trees, sets or maps involved)
+    //
+    // Edges come in two flavors
+    // ... RIGID edges (bone <-> connection) only change with the connection's offsets from its bone (setTranslationFromBone
+    // ... and setRotationFromBone), which is rare
+    // ... COUPLING edges (socket <-> joint) depend on the socket parameters
+    // Both are cached in _locals, and re-read by the updates when the stamp of one of their ends changed (see updateGlobals)
+
+    class FlatSkeleton
+    {
+    public:
+        enum {
+            ROOT = 0,
+            RIGID = 1,
+            COUPLING = 2
+        };
+
+        FlatSkeleton() : _maxDepth(0) {}
+        FlatSkeleton(SkeletonComponent* root) { compile(root); }
+
+        void compile(SkeletonComponent* root);
+        // Same, from the traversal of an update plan (see SkeletonComponent::buildUpdatePlan), which compile(root) builds
+        void compile(const UpdatePlan& plan);
+
+        // Re-reads the local transforms across every socket-joint coupling
+        void refreshCouplings();
+        // Recomputes every global transform from the root's (which is left untouched) and writes them back to the components
+        // ... after re-reading the local transforms of the edges that changed, like updateGlobals
+        void forwardKinematics(UpdateCounters* = NULL);
+        // Recomputes the global transforms of the subtrees below the components that changed since the previous call
+        // ... (the root's is left untouched). Changes are told from the components' stamps (see SkeletonComponent::stamp)
+        // ... against the ones this skeleton saw last, so that other traversals through the same components in between
+        // ... (e.g. the skeleton of another root) can't hide them
+        // The cached local transform of an edge is only re-read when one of its ends changed, so the components that merely
+        // ... moved along with their parents cost a single product each
+        void updateGlobals(UpdateCounters* = NULL);
+        // Same as forwardKinematics(), but the subtrees hanging off forks are handed to the pool as independent tasks
+        // ... subtrees smaller than minParallelSize components are not worth a task and stay with their parent's
+        // (what Body::hardUpdate does once the body is given a pool, see Body::setUpdatePool)
+        void forwardKinematics(ThreadPool& pool, const int& minParallelSize = 256, UpdateCounters* = NULL);
+
+        // Copies the parameters of every coupled socket into (or back out of) the contiguous parameter buffer
+        void gatherParams();
+        void scatterParams() const;
+
+        /////////////////
+        //// GETTERS ////
+        /////////////////
+
+        int size() const { return _components.size(); }
+        SkeletonComponent* root() const { return _components.empty() ? NULL : _components[0]; }
+        SkeletonComponent* component(const int& i) const { return _components[i]; }
+        const std::vector<SkeletonComponent*>& components() const { return _components; }
+        int parent(const int& i) const { return _parents[i]; }
+        int subtreeSize(const int& i) const { return _subtreeSizes[i]; }    // the subtree of i is [i, i + subtreeSize(i))
+        int edgeType(const int& i) const { return _edgeTypes[i]; }
+        int index(SkeletonComponent* component) const;
+        int maxDepth() const { return _maxDepth; }
+
+        const RigidTransform& local(const int& i) const { return _locals[i]; }
+        const RigidTransform& global(const int& i) const { return _globals[i]; }
+
+        std::vector<float>& params() { return _params; }
+        const std::vector<float>& params() const { return _params; }
+        const std::vector<Socket*>& sockets() const { return _sockets; }
+        const std::vector<int>& couplings() const { return _couplings; }
+        int paramOffset(const int& socketIndex) const { return _paramOffsets[socketIndex]; }
+        int nParams(const int& socketIndex) const { return _paramOffsets[socketIndex + 1] - _paramOffsets[socketIndex]; }
+
+    private:
+        RigidTransform rigidTransform(const int& i) const;
+        RigidTransform couplingTransform(const int& i) const;
+        // Re-reads the local transforms of the edges with an end whose stamp changed, noting which in _changed
+        void refreshLocals();
+        void forwardKinematicsSubtree(const int& i, ThreadPool* pool, TaskGroup* group, const int& minParallelSize);
+
+        std::vector<SkeletonComponent*> _components;    // DFS pre-order
+        std::vector<int> _parents;                      // index of the parent in _components (-1 for the root)
+        std::vector<int> _edgeTypes;                    // type of the edge from the parent
+        std::vector<int> _subtreeSizes;
+        std::vector<int> _childCounts;
+        std::vector<RigidTransform> _locals;            // transform from the parent's frame (identity for the root)
+        std::vector<RigidTransform> _globals;
+        std::map<SkeletonComponent*, int> _indices;     // only used for lookups, never during forward kinematics
+        std::vector<unsigned int> _stamps;              // stamp of each component as of the last update
+        std::vector<bool> _changed;                     // scratch space for the updates
+        std::vector<bool> _moved;                       // ...
+        int _maxDepth;
+
+        std::vector<int> _couplings;                    // indices of the components at the far side of a COUPLING edge
+        std::vector<Socket*> _sockets;                  // socket of each entry in _couplings
+        std::vector<int> _paramOffsets;                 // _params[_paramOffsets[k], _paramOffsets[k+1]) belong to _sockets[k]
+        std::vector<int> _paramKeys;                    // key of each entry of _params in its socket's parameter map
+        std::vector<float> _params;
+    };
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,596 @@
+#include "IKSolvers.h"
+
+using namespace Scene;
+using namespace std;
+using namespace glm;
+using namespace Math;
+
+
+IKChain Scene::buildChain(const std::vector<SkeletonComponent*>& armBaseToTip) {
+    IKChain chain;
+    chain.columns.push_back(0);
+    for (int i = 0; i < (int)armBaseToTip.size() - 1; i++) {
+        Connection* connection = dynamic_cast<Connection*>(armBaseToTip[i]);
+        if (connection == NULL || connection->opposingConnection() == NULL) continue;
+
+        Socket* socket = dynamic_cast<Socket*>(connection);
+        if (socket == NULL) socket = dynamic_cast<Joint*>(connection)->socket();
+
+        // Connection::J gives (at most) one column for each of the first three adjustable parameters
+        int nColumns = 0;
+        for (auto param : socket->adjustableParams()) {
+            if (nColumns == 3) break;
+            chain.keys.push_back(param.first);
+            nColumns++;
+        }
+        chain.connections.push_back(connection);
+        chain.pathIndices.push_back(i);
+        chain.sockets.push_back(socket);
+        chain.columns.push_back(chain.columns.back() + nColumns);
+
+        i += 2; // skip over the opposing connection and the bone behind it
+    }
+    return chain;
+}
+
+IKSystem Scene::buildSystem(const std::vector<std::vector<SkeletonComponent*>>& paths) {
+    IKSystem system;
+    system.paths = paths;
+    system.couplings.columns.push_back(0);
+
+    std::map<Socket*, int> couplingIndices;
+    std::set<SkeletonComponent*> components;
+    for (auto& path : paths) {
+        int fork = 0;
+        bool shared = true;
+        int length = path.size();
+        for (int i = 0; i < length; i++) {
+            bool seen = !components.insert(path[i]).second;
+            if (!seen) system.components.push_back(path[i]);
+            shared = shared && seen;
+            if (shared) fork = i;
+        }
+        system.forks.push_back(fork);
+
+        IKChain chain = buildChain(path);
+        std::vector<int> columns(chain.size());
+        int nCouplings = chain.sockets.size();
+        for (int k = 0; k < nCouplings; k++) {
+            // paths sharing a stretch (e.g. up to a fork) share the couplings on it, and so the columns
+            auto it = couplingIndices.find(chain.sockets[k]);
+            if (it == couplingIndices.end()) {
+                IKChain& couplings = system.couplings;
+                it = couplingIndices.insert(std::make_pair(chain.sockets[k], (int)couplings.sockets.size())).first;
+                couplings.connections.push_back(chain.connections[k]);
+                couplings.pathIndices.push_back(chain.pathIndices[k]);
+                couplings.sockets.push_back(chain.sockets[k]);
+                for (int c = chain.columns[k]; c < chain.columns[k + 1]; c++)
+                    couplings.keys.push_back(chain.keys[c]);
+                couplings.columns.push_back(couplings.keys.size());
+            }
+            int offset = system.couplings.columns[it->second];
+            for (int c = chain.columns[k]; c < chain.columns[k + 1]; c++)
+                columns[c] = offset + c - chain.columns[k];
+        }
+        // the couplings of a path that are already in the system are its first ones (the paths share their base)
+        // ... so the columns met earlier along a path always come earlier in the system too
+        system.parentColumns.resize(system.couplings.size(), -1);
+        for (int c = 1; c < chain.size(); c++)
+            system.parentColumns[columns[c]] = columns[c - 1];
+        system.chains.push_back(chain);
+        system.columns.push_back(columns);
+    }
+    return system;
+}
+
+void Scene::updateGlobals(const IKSystem& system, UpdateCounters* counters) {
+    UpdateCounters pass;
+    int nPaths = system.paths.size();
+    for (int p = 0; p < nPaths; p++) {
+        const std::vector<SkeletonComponent*>& path = system.paths[p];
+        Scene::updateGlobals(path, system.forks[p], path.size() - 1, &pass);
+    }
+    if (counters != NULL) {
+        counters->passes++;
+        counters->visited += pass.visited;
+        counters->recomputed += pass.recomputed;
+    }
+}
+
+void Scene::chainJacobian(const IKChain& chain, SkeletonComponent* tip, Math::Matrix& J, const int& row, const bool& rotational) {
+    int nCouplings = chain.connections.size();
+    for (int k = 0; k < nCouplings; k++) {
+        glm::mat3 dt_dparam, dw_dparam;
+        std::tie(dt_dparam, dw_dparam) = chain.connections[k]->J(tip, DOWNSTREAM);
+        for (int c = chain.columns[k]; c < chain.columns[k + 1]; c++) {
+            int column = c - chain.columns[k];
+            for (int i = 0; i < 3; i++) {
+                J(row + i, c) = dt_dparam[column][i];
+                if (rotational) J(row + 3 + i, c) = dw_dparam[column][i];
+            }
+        }
+    }
+}
+
+void Scene::applyChainStep(const IKChain& chain, const std::vector<float>& dParams, const float& scale) {
+    int nCouplings = chain.sockets.size();
+    for (int k = 0; k < nCouplings; k++) {
+        Socket* socket = chain.sockets[k];
+        std::map<int, float> params = socket->params();
+        for (int c = chain.columns[k]; c < chain.columns[k + 1]; c++)
+            params[chain.keys[c]] += scale*dParams[c];
+        socket->setParams(params);
+    }
+}
+
+float Scene::dampedLeastSquaresStep(const Math::Matrix& J, const std::vector<float>& error, const float& extraDamping, std::vector<float>& dParams) {
+    int m = J.rows();
+
+    // Below singularRegion, the smallest singular value of J is treated as vanishing, and the damping ramps up towards maxDamping
+    // ... which keeps the steps bounded where the pseudo-inverse would blow up, without slowing down well-conditioned systems
+    const float singularRegion = 0.1f;
+    const float maxDamping = 0.5f;
+
+    Math::Matrix JJt, V;
+    std::vector<float> sigmaSquared, y(m, 0.0f);
+    outerGram(J, JJt);
+    symmetricEigen(JJt, sigmaSquared, V);
+
+    // With more rows than parameters, J J^T has m - n zero eigenvalues whatever the configuration
+    // ... so the singularities show up in the smallest of the n largest ones
+    std::vector<float> sorted(sigmaSquared);
+    std::sort(sorted.begin(), sorted.end(), std::greater<float>());
+    float sigmaSquaredMin = sorted[std::min(m, J.cols()) - 1];
+    float sigmaSquaredMax = sorted[0];
+    float sigmaMin = sqrt(fmax(0.0f, sigmaSquaredMin));
+    float lambdaSquared = extraDamping*extraDamping;
+    if (sigmaMin < singularRegion)
+        lambdaSquared += (1 - (sigmaMin / singularRegion)*(sigmaMin / singularRegion))*maxDamping*maxDamping;
+
+    // y = (J J^T + lambda^2 I)^-1 error, through the eigenvectors of J J^T
+    for (int k = 0; k < m; k++) {
+        float denominator = fmax(0.0f, sigmaSquared[k]) + lambdaSquared;
+        if (denominator < 1e-12f) continue;
+        float coefficient = 0;
+        for (int i = 0; i < m; i++) coefficient += V(i, k)*error[i];
+        coefficient /= denominator;
+        for (int i = 0; i < m; i++) y[i] += coefficient*V(i, k);
+    }
+    multiplyTransposed(J, y, dParams);
+
+    return sqrt(fmax(0.0f, sigmaSquaredMax));
+}
+
+bool Scene::dlsSetIK(const std::vector<SkeletonComponent*>& armBaseToTip, const glm::vec3& tipTarget, UpdateCounters* counters,
+    IKSolveStats* stats, const IKDeadline& deadline)
+{
+
+    SkeletonComponent* tip = armBaseToTip.back();
+
+    auto backupAll = [&]() {
+        for (auto component : armBaseToTip)
+            component->backup();
+    };
+
+    auto restoreAll = [&]() {
+        for (auto component : armBaseToTip)
+            component->restore();
+    };
+
+    glm::vec3 stepToTarget = tipTarget - tip->globalTranslation();
+    float distanceToTarget = glm::length(stepToTarget);
+
+    IKChain chain = buildChain(armBaseToTip);
+    int n = chain.size();
+    if (n == 0) return distanceToTarget < 0.01f;
+
+    backupAll();
+
+    // Rejected steps add extraDamping on top of the adaptive damping (shortening and turning the next step towards J^T)
+    // ... and accepted steps relax it
+    float extraDamping = 0;
+
+    Math::Matrix J(3, n);
+    std::vector<float> error(3), dParams;
+
+    int maxIterations = 32;
+    for (int iteration = 0; iteration < maxIterations && distanceToTarget > 0.01f; iteration++) {
+        if (pastDeadline(deadline, stats)) break;
+        if (stats != NULL) stats->iterations++;
+
+        chainJacobian(chain, tip, J);
+        for (int i = 0; i < 3; i++) error[i] = stepToTarget[i];
+        float sigmaMax = dampedLeastSquaresStep(J, error, extraDamping, dParams);
+
+        applyChainStep(chain, dParams);
+        Scene::updateGlobals(armBaseToTip, counters);
+
+        glm::vec3 newStepToTarget = tipTarget - tip->globalTranslation();
+        float newDistanceToTarget = glm::length(newStepToTarget);
+
+        if (newDistanceToTarget < distanceToTarget) {
+            backupAll();
+            distanceToTarget = newDistanceToTarget;
+            stepToTarget = newStepToTarget;
+            extraDamping /= 2;
+        }
+        else {
+            restoreAll();
+            if (stats != NULL) stats->rejectedSteps++;
+            extraDamping = fmax(2 * extraDamping, sigmaMax / 4);
+        }
+    }
+    return distanceToTarget < 0.01f;
+}
+
+namespace {
+    // Every path gets 3 rows for its tip's translation and 3 for its rotation, unless the target leaves them free (weight 0)
+    // Path p's rows are [rows[p], rows[p + 1])
+    std::vector<int> stackedRows(const std::vector<IKTarget>& tipTargets) {
+        int nPaths = tipTargets.size();
+        std::vector<int> rows(nPaths + 1, 0);
+        for (int p = 0; p < nPaths; p++) {
+            rows[p + 1] = rows[p];
+            if (tipTargets[p].translationWeight > 0) rows[p + 1] += 3;
+            if (tipTargets[p].rotationWeight > 0) rows[p + 1] += 3;
+        }
+        return rows;
+    }
+
+    // Stacks the weighted steps of the tips to their targets (the rotational ones as global axis-angle)
+    // ... and tells whether every tip is within tolerance of its target
+    bool stackedResiduals(const IKSystem& system, const std::vector<IKTarget>& tipTargets, const std::vector<int>& rows,
+        std::vector<float>& error)
+    {
+        bool converged = true;
+        int nPaths = system.paths.size();
+        for (int p = 0; p < nPaths; p++) {
+            const IKTarget& target = tipTargets[p];
+            SkeletonComponent* tip = system.paths[p].back();
+            int row = rows[p];
+            if (target.translationWeight > 0) {
+                glm::vec3 step = target.translation - tip->globalTranslation();
+                for (int i = 0; i < 3; i++) error[row + i] = target.translationWeight*step[i];
+                converged = converged && glm::length(step) < 0.01f;
+                row += 3;
+            }
+            if (target.rotationWeight > 0) {
+                glm::vec3 turn = Math::w(target.rotation*glm::conjugate(tip->globalQuaternion()));
+                for (int i = 0; i < 3; i++) error[row + i] = target.rotationWeight*turn[i];
+                converged = converged && glm::length(turn) < 0.01f;
+            }
+        }
+        return converged;
+    }
+
+    // The weighted rows of path p, over the columns of its own chain (see IKSystem::columns for where they go in the system)
+    void stackedChainJacobian(const IKSystem& system, const int& p, const IKTarget& target, Math::Matrix& chainJ, Math::Matrix& J) {
+        int nColumns = system.chains[p].size();
+        chainJ.resize(6, nColumns);
+        chainJacobian(system.chains[p], system.paths[p].back(), chainJ, 0, target.rotationWeight > 0);
+
+        J.resize(((target.translationWeight > 0) ? 3 : 0) + ((target.rotationWeight > 0) ? 3 : 0), nColumns);
+        for (int c = 0; c < nColumns; c++) {
+            int r = 0;
+            if (target.translationWeight > 0) {
+                for (int i = 0; i < 3; i++) J(r + i, c) = target.translationWeight*chainJ(i, c);
+                r += 3;
+            }
+            if (target.rotationWeight > 0) {
+                for (int i = 0; i < 3; i++) J(r + i, c) = target.rotationWeight*chainJ(3 + i, c);
+            }
+        }
+    }
+
+    float squaredNorm(const std::vector<float>& error) {
+        float sum = 0;
+        for (auto e : error) sum += e*e;
+        return sum;
+    }
+}
+
+bool Scene::dlsSetIK(IKSystem& system, const std::vector<IKTarget>& tipTargets, UpdateCounters* counters, IKSolveStats* stats,
+    const IKDeadline& deadline)
+{
+
+    int nPaths = system.paths.size();
+    int n = system.size();
+
+    auto backupAll = [&]() {
+        for (auto component : system.components)
+            component->backup();
+    };
+
+    auto restoreAll = [&]() {
+        for (auto component : system.components)
+            component->restore();
+    };
+
+    std::vector<int> rows = stackedRows(tipTargets);
+    int m = rows[nPaths];
+
+    std::vector<float> error(m), newError(m), dParams;
+    bool converged = stackedResiduals(system, tipTargets, rows, error);
+    float cost = squaredNorm(error);
+    if (n == 0 || m == 0) return converged;
+
+    backupAll();
+
+    float extraDamping = 0;
+
+    Math::Matrix J(m, n), chainJ, pathJ;
+
+    int maxIterations = 32;
+    for (int iteration = 0; iteration < maxIterations && !converged; iteration++) {
+        if (pastDeadline(deadline, stats)) break;
+        if (stats != NULL) stats->iterations++;
+
+        J.setZero();
+        for (int p = 0; p < nPaths; p++) {
+            stackedChainJacobian(system, p, tipTargets[p], chainJ, pathJ);
+            for (int r = 0; r < pathJ.rows(); r++)
+                for (int c = 0; c < pathJ.cols(); c++)
+                    J(rows[p] + r, system.columns[p][c]) = pathJ(r, c);
+        }
+        float sigmaMax = dampedLeastSquaresStep(J, error, extraDamping, dParams);
+
+        applyChainStep(system.couplings, dParams);
+        Scene::updateGlobals(system, counters);
+
+        bool newConverged = stackedResiduals(system, tipTargets, rows, newError);
+        float newCost = squaredNorm(newError);
+
+        if (newCost < cost) {
+            backupAll();
+            converged = newConverged;
+            cost = newCost;
+            error.swap(newError);
+            extraDamping /= 2;
+        }
+        else {
+            restoreAll();
+            if (stats != NULL) stats->rejectedSteps++;
+            extraDamping = fmax(2 * extraDamping, sigmaMax / 4);
+        }
+    }
+    return converged;
+}
+
+bool Scene::lmSetIK(IKSystem& system, const std::vector<IKTarget>& tipTargets, UpdateCounters* counters, IKSolveStats* stats,
+    const IKDeadline& deadline)
+{
+
+    int nPaths = system.paths.size();
+    int n = system.size();
+
+    auto backupAll = [&]() {
+        for (auto component : system.components)
+            component->backup();
+    };
+
+    auto restoreAll = [&]() {
+        for (auto component : system.components)
+            component->restore();
+    };
+
+    std::vector<int> rows = stackedRows(tipTargets);
+    int m = rows[nPaths];
+
+    std::vector<float> error(m), newError(m);
+    bool converged = stackedResiduals(system, tipTargets, rows, error);
+    float cost = squaredNorm(error);
+    if (n == 0 || m == 0) return converged;
+
+    backupAll();
+
+    // J^T J and J^T error, accumulated path by path: the rows of a path only touch the columns of its own chain
+    // ... and every pair of those is an ancestor and a descendant in the system's column tree
+    Math::TreeSymmetricMatrix JtJ(system.parentColumns), A;
+    std::vector<float> Jte(n), dParams;
+    Math::Matrix chainJ, pathJ;
+    auto normalEquations = [&]() {
+        JtJ.setZero();
+        std::fill(Jte.begin(), Jte.end(), 0.0f);
+        for (int p = 0; p < nPaths; p++) {
+            stackedChainJacobian(system, p, tipTargets[p], chainJ, pathJ);
+            const std::vector<int>& columns = system.columns[p];
+            for (int a = 0; a < pathJ.cols(); a++) {
+                for (int r = 0; r < pathJ.rows(); r++)
+                    Jte[columns[a]] += pathJ(r, a)*error[rows[p] + r];
+                for (int b = 0; b <= a; b++) {
+                    float sum = 0;
+                    for (int r = 0; r < pathJ.rows(); r++)
+                        sum += pathJ(r, a)*pathJ(r, b);
+                    JtJ(columns[b], columns[a]) += sum;
+                }
+            }
+        }
+    };
+    normalEquations();
+
+    // mu starts small against the curvature and follows the gain ratio (Nielsen's update)
+    float mu = 0;
+    for (int j = 0; j < n; j++) mu = fmax(mu, JtJ(j, j));
+    mu = fmax(1e-3f*mu, 1e-6f);
+    float nu = 2;
+
+    int maxIterations = 32;
+    for (int iteration = 0; iteration < maxIterations && !converged; iteration++) {
+        if (pastDeadline(deadline, stats)) break;
+        if (stats != NULL) stats->iterations++;
+
+        // (J^T J + mu I) dParams = J^T error
+        A = JtJ;
+        for (int j = 0; j < n; j++) A(j, j) += mu;
+        dParams = Jte;
+        if (!A.choleskySolve(dParams)) {
+            mu *= nu;
+            nu *= 2;
+            continue;
+        }
+
+        float predictedDecrease = 0;
+        for (int j = 0; j < n; j++) predictedDecrease += dParams[j] * (mu*dParams[j] + Jte[j]);
+
+        applyChainStep(system.couplings, dParams);
+        Scene::updateGlobals(system, counters);
+
+        bool newConverged = stackedResiduals(system, tipTargets, rows, newError);
+        float newCost = squaredNorm(newError);
+
+        float gain = (predictedDecrease > 0) ? (cost - newCost) / predictedDecrease : -1;
+        if (gain > 0) {
+            backupAll();
+            converged = newConverged;
+            cost = newCost;
+            error.swap(newError);
+            mu *= fmax(1.0f / 3, 1 - pow(2 * gain - 1, 3));
+            nu = 2;
+            if (!converged) normalEquations();
+        }
+        else {
+            // the normal equations still hold at the restored pose, only mu changes
+            restoreAll();
+            if (stats != NULL) stats->rejectedSteps++;
+            mu *= nu;
+            nu *= 2;
+        }
+    }
+    return converged;
+}
+
+bool Scene::fabrikSetIK(const std::vector<SkeletonComponent*>& armBaseToTip, const glm::vec3& tipTarget, UpdateCounters* counters,
+    IKSolveStats* stats, const IKDeadline& deadline)
+{
+
+    SkeletonComponent* tip = armBaseToTip.back();
+    int last = armBaseToTip.size() - 1;
+
+    auto backupAll = [&]() {
+        for (auto component : armBaseToTip)
+            component->backup();
+    };
+
+    auto restoreAll = [&]() {
+        for (auto component : armBaseToTip)
+            component->restore();
+    };
+
+    float distanceToTarget = glm::length(tipTarget - tip->globalTranslation());
+
+    IKChain chain = buildChain(armBaseToTip);
+    int m = chain.connections.size();
+    if (m == 0) return distanceToTarget < 0.01f;
+
+    // points[k] is the pivot of the k-th coupling (which stays put when the coupling turns), and points[m] the tip
+    auto pivot = [&](const int& k) {
+        return (k < m) ? chain.sockets[k]->joint()->globalTranslation() : tip->globalTranslation();
+    };
+    // Turning the k-th coupling moves everything up to the tip, but the next step only needs the globals up to the pivot after next
+    auto stretchEnd = [&](const int& k) {
+        return (k < m) ? chain.pathIndices[k] + 1 : last;
+    };
+
+    std::vector<glm::vec3> points(m + 1), reached(m + 1);
+    std::vector<float> lengths(m);
+    for (int k = 0; k <= m; k++) points[k] = pivot(k);
+    for (int k = 0; k < m; k++) lengths[k] = glm::length(points[k + 1] - points[k]);
+
+    backupAll();
+
+    int maxIterations = 16;
+    for (int iteration = 0; iteration < maxIterations && distanceToTarget > 0.01f; iteration++) {
+        if (pastDeadline(deadline, stats)) break;
+        if (stats != NULL) stats->iterations++;
+
+        // backward: drag the tip onto the target and every pivot after it, keeping the lengths
+        reached[m] = tipTarget;
+        for (int k = m - 1; k >= 0; k--) {
+            glm::vec3 direction = points[k] - reached[k + 1];
+            if (glm::length(direction) < 1e-6f) direction = points[k] - points[k + 1];
+            reached[k] = reached[k + 1] + lengths[k] * glm::normalize(direction);
+        }
+        // forward: pin the base back in place and pull the rest along
+        reached[0] = points[0];
+        for (int k = 0; k < m; k++) {
+            glm::vec3 direction = reached[k + 1] - reached[k];
+            if (glm::length(direction) < 1e-6f) direction = points[k + 1] - points[k];
+            reached[k + 1] = reached[k] + lengths[k] * glm::normalize(direction);
+        }
+
+        // turn each coupling so that the next pivot heads for its reached position, projecting onto the joint limits as we go
+        for (int k = 0; k < m; k++) {
+            glm::vec3 from = pivot(k + 1) - pivot(k);
+            glm::vec3 to = reached[k + 1] - pivot(k);
+            if (glm::length(from) > 1e-6f && glm::length(to) > 1e-6f) {
+                chain.connections[k]->turnCoupling(Math::q(from, to), DOWNSTREAM);
+                Scene::updateGlobals(armBaseToTip, chain.pathIndices[k], stretchEnd(k + 2), counters);
+            }
+        }
+
+        float newDistanceToTarget = glm::length(tipTarget - tip->globalTranslation());
+        if (newDistanceToTarget < distanceToTarget) {
+            backupAll();
+            distanceToTarget = newDistanceToTarget;
+            for (int k = 0; k <= m; k++) points[k] = pivot(k);
+        }
+        else {
+            // the limits are keeping the chain from getting any closer
+            restoreAll();
+            if (stats != NULL) stats->rejectedSteps++;
+            break;
+        }
+    }
+    return distanceToTarget < 0.01f;
+}
+
+bool Scene::ccdSetIK(const std::vector<SkeletonComponent*>& armBaseToTip, const glm::vec3& tipTarget, UpdateCounters* counters,
+    IKSolveStats* stats, const IKDeadline& deadline)
+{
+
+    SkeletonComponent* tip = armBaseToTip.back();
+    int last = armBaseToTip.size() - 1;
+
+    float distanceToTarget = glm::length(tipTarget - tip->globalTranslation());
+
+    IKChain chain = buildChain(armBaseToTip);
+    int m = chain.connections.size();
+
+    int maxSweeps = 16;
+    for (int sweep = 0; sweep < maxSweeps && m > 0 && distanceToTarget > 0.01f; sweep++) {
+        if (pastDeadline(deadline, stats)) break;
+        if (stats != NULL) stats->iterations++;
+        for (int k = m - 1; k >= 0 && distanceToTarget > 0.01f; k--) {
+            // the coupling turns about its joint's origin, which the turns further down the chain didn't move
+            glm::vec3 pivot = chain.sockets[k]->joint()->globalTranslation();
+            glm::vec3 from = tip->globalTranslation() - pivot;
+            glm::vec3 to = tipTarget - pivot;
+            if (glm::length(from) < 1e-6f || glm::length(to) < 1e-6f) continue;
+
+            chain.connections[k]->turnCoupling(Math::q(from, to), DOWNSTREAM);
+            Scene::updateGlobals(armBaseToTip, chain.pathIndices[k], last, counters);
+            distanceToTarget = glm::length(tipTarget - tip->globalTranslation());
+        }
+    }
+    return distanceToTarget < 0.01f;
+}
+
+bool Scene::solveIK(const int& solver, const std::vector<SkeletonComponent*>& armBaseToTip, const glm::vec3& tipTarget, UpdateCounters* counters,
+    IKWarmStart* warmStart, IKSolveStats* stats, const IKDeadline& deadline, const IKReach* reach)
+{
+    switch (solver) {
+    case DLS_IK:
+    case STACKED_IK:
+        return dlsSetIK(armBaseToTip, tipTarget, counters, stats, deadline);
+    case SPARSE_LM_IK: {
+        IKSystem system = buildSystem(std::vector<std::vector<SkeletonComponent*>>({ armBaseToTip }));
+        return lmSetIK(system, std::vector<IKTarget>({ IKTarget(tipTarget) }), counters, stats, deadline);
+    }
+    case FABRIK_IK:
+        return fabrikSetIK(armBaseToTip, tipTarget, counters, stats, deadline);
+    case CCD_IK:
+        return ccdSetIK(armBaseToTip, tipTarget, counters, stats, deadline);
+    default:
+        return linearSetIK(armBaseToTip, tipTarget, counters, warmStart, stats, deadline, reach);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,120 @@
+#ifndef _IKSOLVERS_H_
+#define _IKSOLVERS_H_
+
+#include "stdafx.h"
+#include "BodyComponents.h"
+#include "Matrix.h"
+
+// Alternatives to linearSetIK (see BodyComponents.h) that treat the couplings along an effector path as one system
+// ... instead of nudging each socket on its own
+
+enum {
+    LINEAR_IK = 0,  // linearSetIK: per-socket Jacobian transpose steps, halved until the tip gets closer
+    DLS_IK = 1,     // dlsSetIK: damped least squares over the whole chain
+    FABRIK_IK = 2,  // fabrikSetIK: forward and backward reaching on the pivot positions, no Jacobian at all
+    CCD_IK = 3,     // ccdSetIK: cyclic coordinate descent, one coupling at a time from the tip back to the base
+    STACKED_IK = 4, // the effector and every anchor of its body solved together as one system (see Body::setTranslations)
+    SPARSE_LM_IK = 5 // the same system, solved by Levenberg-Marquardt on its sparse normal equations (lmSetIK)
+};
+
+namespace Scene {
+
+    // The socket-joint couplings along a path from its base to its tip, and the layout of the chain Jacobian over them
+    struct IKChain {
+        std::vector<Connection*> connections;   // the connection of each coupling that is met first walking from the base
+        std::vector<int> pathIndices;           // index of each of the above in the path
+        std::vector<Socket*> sockets;
+        std::vector<int> columns;               // columns [columns[k], columns[k + 1]) of the Jacobian belong to sockets[k]
+        std::vector<int> keys;                  // parameter key (in its socket) of each column
+
+        int size() const { return keys.size(); }
+    };
+
+    IKChain buildChain(const std::vector<SkeletonComponent*>& armBaseToTip);
+
+    // Several paths sharing their base (e.g. from a body's root anchor to its effectors and to its other anchors)
+    // ... to be solved as one system, whose unknowns are the parameters of every coupling met along any of the paths
+    struct IKSystem {
+        std::vector<std::vector<SkeletonComponent*>> paths;
+        std::vector<IKChain> chains;                    // one per path
+        std::vector<std::vector<int>> columns;          // column of the system for each column of chains[p]
+        IKChain couplings;                              // every coupling of the system once, laid out in the system's columns
+        std::vector<int> parentColumns;                 // column met just before each column along the paths (-1 at the base)
+        std::vector<SkeletonComponent*> components;     // every component on any of the paths once
+        std::vector<int> forks;                         // per path, the last index of its stretch shared with the paths before
+
+        int size() const { return couplings.size(); }
+    };
+
+    IKSystem buildSystem(const std::vector<std::vector<SkeletonComponent*>>& paths);
+    // Same as the path version of updateGlobals over every path of the system, in a single pass: each path is only
+    // ... recomputed past its fork, the stretch up to there having been recomputed along with the paths before it
+    void updateGlobals(const IKSystem&, UpdateCounters* = NULL);
+
+    // Fills rows [row, row + 3) of J with the derivatives of the tip's global translation with respect to every chain parameter
+    // ... and, if rotational, rows [row + 3, row + 6) with the tip's angular velocity per parameter (see Connection::J)
+    // J must already have the chain's size() columns; the globals along the path are assumed to be up to date
+    void chainJacobian(const IKChain&, SkeletonComponent* tip, Math::Matrix& J, const int& row = 0, const bool& rotational = false);
+
+    // Where the tip of a path should end up, position and (optionally) orientation
+    // The weights scale the rows of the residual: an error of one radian counts like rotationWeight units of length
+    // ... and a weight of 0 leaves that part of the transform free
+    struct IKTarget {
+        IKTarget(const glm::vec3& t = glm::vec3(0, 0, 0)) : translation(t), rotation(glm::quat()), translationWeight(1), rotationWeight(0) {}
+        IKTarget(const glm::vec3& t, const glm::quat& q, const float& tWeight = 1, const float& wWeight = 1) :
+            translation(t), rotation(q), translationWeight(tWeight), rotationWeight(wWeight) {}
+
+        glm::vec3 translation;
+        glm::quat rotation;
+        float translationWeight;
+        float rotationWeight;
+    };
+
+    // Adds scale*dParams (one entry per column) to the chain's parameters, through the sockets' constraints
+    void applyChainStep(const IKChain&, const std::vector<float>& dParams, const float& scale = 1);
+
+    // One damped least squares step dParams = J^T (J J^T + lambda^2 I)^-1 error over all the rows of J
+    // lambda ramps up as the smallest singular value of J vanishes, on top of whatever extraDamping the caller asks for
+    // Returns the largest singular value of J, which gives the caller a scale for that extra damping
+    float dampedLeastSquaresStep(const Math::Matrix& J, const std::vector<float>& error, const float& extraDamping, std::vector<float>& dParams);
+
+    // Same contract as linearSetIK, but every iteration solves for all the chain's parameters at once
+    // ... dParams = J^T (J J^T + lambda^2 I)^-1 error, with lambda growing as the chain approaches a singular configuration
+    bool dlsSetIK(const std::vector<SkeletonComponent*>& armBaseToTip, const glm::vec3& tipTarget, UpdateCounters* = NULL, IKSolveStats* = NULL,
+        const IKDeadline& = IKDeadline::max());
+
+    // Moves the tip of every path of the system onto its target at once: the weighted residuals of all the paths are stacked
+    // ... into one damped least squares step per iteration (the rotational rows use the angular velocities of Connection::J)
+    // ... followed by one update of every path
+    // Succeeds if every tip ends up within tolerance of its target (0.01 in length, 0.01 radians in rotation)
+    bool dlsSetIK(IKSystem&, const std::vector<IKTarget>& tipTargets, UpdateCounters* = NULL, IKSolveStats* = NULL,
+        const IKDeadline& = IKDeadline::max());
+
+    // Same contract as the above, but each iteration solves the normal equations (J^T J + mu I) dParams = J^T error
+    // ... with mu adapted by the gain ratio. J^T J is accumulated path by path and factorized along the system's column tree
+    // ... (see Math::TreeSymmetricMatrix), so an iteration costs about the squared lengths of the paths, whatever the DOF of the skeleton
+    bool lmSetIK(IKSystem&, const std::vector<IKTarget>& tipTargets, UpdateCounters* = NULL, IKSolveStats* = NULL,
+        const IKDeadline& = IKDeadline::max());
+
+    // Position-only FABRIK on the pivots of the chain's couplings (the joints' origins) and the tip
+    // Each iteration reaches backward from the target and forward from the base, then turns the couplings base to tip
+    // ... onto the new positions, so the sockets' constraints get applied (and the rest of the pass adapts to them) as it goes
+    bool fabrikSetIK(const std::vector<SkeletonComponent*>& armBaseToTip, const glm::vec3& tipTarget, UpdateCounters* = NULL, IKSolveStats* = NULL,
+        const IKDeadline& = IKDeadline::max());
+
+    // Cyclic coordinate descent: each sweep turns the couplings, tip to base, so that the tip heads straight for the target
+    // ... clamped by the sockets' constraints. There is no line search and nothing is ever backed up or restored,
+    // ... so a sweep always costs one turn and one partial path update per coupling
+    bool ccdSetIK(const std::vector<SkeletonComponent*>& armBaseToTip, const glm::vec3& tipTarget, UpdateCounters* = NULL, IKSolveStats* = NULL,
+        const IKDeadline& = IKDeadline::max());
+
+    // Every solver above stops at the deadline (checked once per iteration), keeping the best pose it has found by then
+
+    // Dispatches to the solver named by one of the *_IK constants above (a lone path under STACKED_IK is just solved by DLS)
+    // Only linearSetIK has a use for the warm start and the reach; the others build their step from scratch every iteration anyway
+    bool solveIK(const int& solver, const std::vector<SkeletonComponent*>& armBaseToTip, const glm::vec3& tipTarget, UpdateCounters* = NULL,
+        IKWarmStart* = NULL, IKSolveStats* = NULL, const IKDeadline& = IKDeadline::max(), const IKReach* = NULL);
+
+}
+
+#endif
\ No newline at end of file
@@ -18,6 +18,9 @@ Socket* Joint::couple(Socket* socket) {
         }
         socket->_joint = this;
         _socket = socket;
+        markDirty();
+        socket->markDirty();
+        touchTopology();
     }
     return socket;
 }
@@ -29,7 +32,10 @@ void Joint::decouple() {
             bone->_joints.insert(this);         // 3: Reattach this socket to its anchor without skeleton updates
         }
         _socket->_joint = NULL;                 // 4: Sever the socket-joint link
+        _socket->markDirty();                   //    ...
         _socket = NULL;                         //    ...
+        markDirty();
+        touchTopology();
     }
 }
 
@@ -52,22 +52,19 @@ glm::vec3 Math::composeLocalRotations(const glm::vec3& w0, const glm::vec3& w1)
     float angle1 = glm::length(w1);
     if (angle0 == 0) return w1;
     if (angle1 == 0) return w0;
-    glm::mat3 R0 = Math::R(w0);
-    glm::vec3 w1_frame0 = R0*w1;
-    glm::mat3 R = Math::R(w1_frame0)*R0;
-    return Math::w(R);
+    // R(R0*w1)*R0 == R0*R(w1), so the composition is just the quaternion product
+    return Math::w(Math::q(w0)*Math::q(w1));
 }
 AxisAngleRotation2 Math::composeLocalRotations(const AxisAngleRotation2& axisAngle0, const AxisAngleRotation2& axisAngle1) {
     glm::vec3 w = composeLocalRotations(axisAngle0.axisAngleRotation3(), axisAngle1.axisAngleRotation3());
     return AxisAngleRotation2(w);
 }
 glm::vec3 Math::composeLocalRotations(const std::vector<glm::vec3>& localRotations) {
-    glm::mat3 R;
+    glm::quat q;
     for (auto w_local : localRotations) {
-        glm::vec3 w_global = R*w_local;
-        R = Math::R(w_global)*R;
+        q = q*Math::q(w_local);
     }
-    return Math::w(R);
+    return Math::w(q);
 }
 AxisAngleRotation2 Math::composeLocalRotations(const std::vector<AxisAngleRotation2>& localRotations) {
     std::vector<glm::vec3> ws(localRotations.size());
@@ -77,20 +74,37 @@ AxisAngleRotation2 Math::composeLocalRotations(const std::vector<AxisAngleRotati
 }
 std::vector<std::pair<glm::vec3, glm::vec3>>
 Math::composeLocalTransforms(const std::vector<std::pair<glm::vec3, glm::vec3>>& localTransforms)
+{
+    std::vector<std::pair<glm::vec3, glm::vec3>> composedTransforms(localTransforms.size());
+    composeLocalTransforms(localTransforms, composedTransforms);
+    return composedTransforms;
+}
+void Math::composeLocalTransforms(
+    const std::vector<std::pair<glm::vec3, glm::vec3>>& localTransforms,
+    std::vector<std::pair<glm::vec3, glm::vec3>>& composedTransforms)
 {
     int nTransforms = localTransforms.size();
-    std::vector<std::pair<glm::vec3,glm::vec3>> composedTransforms(nTransforms);
-    glm::vec3 t(0,0,0), t_local, w_local;
-    glm::mat3 R;
+    if ((int)composedTransforms.size() != nTransforms) composedTransforms.resize(nTransforms);
+    glm::vec3 t(0, 0, 0);
+    glm::quat q;
     for (int i = 0; i < nTransforms; i++) {
-        std::tie(t_local, w_local) = localTransforms[i];
-        glm::vec3 t_global = R*t_local;
-        glm::vec3 w_global = R*w_local;
-        R = Math::R(w_global)*R;
-        t += t_global;
-        composedTransforms[i] = std::make_pair(t, Math::w(R));
+        t += q*localTransforms[i].first;
+        q = glm::normalize(q*Math::q(localTransforms[i].second));
+        composedTransforms[i] = std::make_pair(t, Math::w(q));
     }
-    return composedTransforms;
+}
+std::pair<glm::vec3, glm::vec3> Math::composeAllLocalTransforms(const std::pair<glm::vec3, glm::vec3>* localTransforms, const int& nTransforms) {
+    glm::vec3 t(0, 0, 0);
+    glm::quat q;
+    for (int i = 0; i < nTransforms; i++) {
+        t += q*localTransforms[i].first;
+        q = q*Math::q(localTransforms[i].second);
+    }
+    return std::make_pair(t, Math::w(glm::normalize(q)));
+}
+std::pair<glm::vec3, glm::vec3> Math::composeAllLocalTransforms(const std::vector<std::pair<glm::vec3, glm::vec3>>& localTransforms) {
+    if (localTransforms.empty()) return std::make_pair(glm::vec3(0, 0, 0), glm::vec3(0, 0, 0));
+    return composeAllLocalTransforms(&localTransforms[0], localTransforms.size());
 }
 
 glm::mat3 Math::R(const glm::vec3& w) {
@@ -120,6 +134,31 @@ glm::mat3 Math::R(const glm::vec2& axis, const float& angle) {
 glm::mat3 Math::R(const float& angle, const glm::vec2& axis) {
     return Math::R(Math::w(axis, angle));
 }
+glm::mat3 Math::R(const glm::quat& q) {
+    return glm::mat3_cast(q);
+}
+
+glm::quat Math::q(const glm::vec3& w) {
+    float angle = glm::length(w);
+    if (angle == 0) return glm::quat();
+    glm::vec3 v = w*(sin(angle / 2) / angle);
+    return glm::quat(cos(angle / 2), v[0], v[1], v[2]);
+}
+glm::quat Math::q(const glm::mat3& R) {
+    return glm::normalize(glm::quat_cast(R));
+}
+glm::quat Math::q(const glm::vec3& from, const glm::vec3& to) {
+    glm::vec3 a = glm::normalize(from);
+    glm::vec3 b = glm::normalize(to);
+    float c = glm::dot(a, b);
+    if (c < -0.999999f) {
+        // any half turn about an axis perpendicular to a will do
+        glm::vec3 axis = glm::normalize(glm::cross(a, (fabs(a[0]) < 0.9f) ? glm::vec3(1, 0, 0) : glm::vec3(0, 1, 0)));
+        return glm::quat(0, axis[0], axis[1], axis[2]);
+    }
+    glm::vec3 axis = glm::cross(a, b);
+    return glm::normalize(glm::quat(1 + c, axis[0], axis[1], axis[2]));
+}
 
 
 glm::vec3 Math::w(const glm::mat3& R) {
@@ -146,6 +185,15 @@ glm::vec3 Math::w(const glm::mat3& R) {
         return glm::vec3(R[1][2] - R[2][1], R[2][0] - R[0][2], R[0][1] - R[1][0])*theta / (2 * sin(theta));
     }
 }
+glm::vec3 Math::w(const glm::quat& qIn) {
+    // q and -q are the same rotation; pick the representative with angle in [0, pi]
+    glm::quat q = (qIn.w < 0) ? -qIn : qIn;
+    glm::vec3 v(q.x, q.y, q.z);
+    float sinHalfAngle = glm::length(v);
+    if (sinHalfAngle == 0) return glm::vec3(0, 0, 0);
+    float angle = 2 * atan2(sinHalfAngle, q.w);
+    return v*(angle / sinHalfAngle);
+}
 AxisAngleRotation2 Math::axisAngleRotation2(const glm::mat3& R) {
     return AxisAngleRotation2(Math::w(R));
 }
@@ -19,6 +19,14 @@ namespace Math {
     glm::mat3 R(const AxisAngleRotation2&);
     glm::mat3 R(const glm::vec2&, const float&);
     glm::mat3 R(const float&, const glm::vec2&);
+    glm::mat3 R(const glm::quat&);
+
+    // Unit quaternions are used internally wherever rotations are chained, since composing them
+    // ... requires neither trig nor a round trip through the rotation matrix
+    glm::quat q(const glm::vec3&);
+    glm::quat q(const glm::mat3&);
+    // The shortest rotation turning the direction of the former vector into that of the latter
+    glm::quat q(const glm::vec3& from, const glm::vec3& to);
     // The following gives the matrix for changing from the former coordinate axes to the latter coordinate axes
     // e.g. To reexpress v (currently expressed in the former basis) in the latter basis,
     // ...  use basisChangeMatrix(former basis, latter basis)*v
@@ -41,11 +49,19 @@ namespace Math {
     glm::vec3 composeLocalRotations(const std::vector<glm::vec3>&);
     AxisAngleRotation2 composeLocalRotations(const std::vector<AxisAngleRotation2>&);
     std::vector<std::pair<glm::vec3, glm::vec3>> composeLocalTransforms(const std::vector<std::pair<glm::vec3, glm::vec3>>&);
+    // Same as above, but writes the composed prefixes into caller-owned storage (reallocating only if it is too small)
+    void composeLocalTransforms(const std::vector<std::pair<glm::vec3, glm::vec3>>&, std::vector<std::pair<glm::vec3, glm::vec3>>&);
+    // The following only return the composition of the whole chain (i.e. the back() of the above)
+    std::pair<glm::vec3, glm::vec3> composeAllLocalTransforms(const std::pair<glm::vec3, glm::vec3>*, const int&);
+    std::pair<glm::vec3, glm::vec3> composeAllLocalTransforms(const std::vector<std::pair<glm::vec3, glm::vec3>>&);
+    template <std::size_t N>
+    std::pair<glm::vec3, glm::vec3> composeAllLocalTransforms(const std::array<std::pair<glm::vec3, glm::vec3>, N>&);
 
     glm::vec3 w(const glm::vec2& axis, const float& angle);
     glm::vec3 w(const float& angle, const glm::vec2& axis);
     glm::vec3 w(const AxisAngleRotation2& axisAngle);
     glm::vec3 w(const glm::mat3& R);
+    glm::vec3 w(const glm::quat& q);
 
     AxisAngleRotation2 axisAngleRotation2(const glm::vec3&);
     AxisAngleRotation2 axisAngleRotation2(const glm::mat3&);
@@ -64,6 +80,18 @@ namespace Math {
     glm::vec3 axisAngleAlignZYtoVECS3(const glm::vec3& zIn, const glm::vec3& yIn);
     AxisAngleRotation2 axisAngleAlignZYtoVECS2(const glm::vec3& zIn, const glm::vec3& yIn);
 
+    // The chain length is a compile-time constant here, so the loop can be fully unrolled
+    template <std::size_t N>
+    std::pair<glm::vec3, glm::vec3> composeAllLocalTransforms(const std::array<std::pair<glm::vec3, glm::vec3>, N>& localTransforms) {
+        glm::vec3 t(0, 0, 0);
+        glm::quat q;
+        for (std::size_t i = 0; i < N; i++) {
+            t += q*localTransforms[i].first;
+            q = q*Math::q(localTransforms[i].second);
+        }
+        return std::make_pair(t, Math::w(glm::normalize(q)));
+    }
+
 }
 
 #endif
\ No newline at end of file
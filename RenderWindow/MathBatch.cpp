@@ -0,0 +1,211 @@
+#include "MathBatch.h"
+
+#if defined(__AVX2__)
+    #define MATH_BATCH_AVX2
+#endif
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define MATH_BATCH_SSE2
+#endif
+
+#if defined(MATH_BATCH_AVX2) || defined(MATH_BATCH_SSE2)
+    #include <immintrin.h>
+#endif
+
+using namespace Math;
+
+///////////////////////
+//// BATCH STORAGE ////
+///////////////////////
+
+Vec3Batch::Vec3Batch(const std::vector<glm::vec3>& vs) : x(vs.size()), y(vs.size()), z(vs.size()) {
+    int n = vs.size();
+    for (int i = 0; i < n; i++) set(i, vs[i]);
+}
+std::vector<glm::vec3> Vec3Batch::unpack() const {
+    int n = size();
+    std::vector<glm::vec3> vs(n);
+    for (int i = 0; i < n; i++) vs[i] = get(i);
+    return vs;
+}
+
+/////////////////////
+//// LANE TRAITS ////
+/////////////////////
+
+// Each traits class wraps one instruction set behind the same set of names, so that every kernel below is written once
+// ... V is a register of floats, I a register of ints, and masks are V's with all bits set in the selected lanes
+
+namespace {
+
+#ifdef MATH_BATCH_SSE2
+    struct Sse {
+        typedef __m128 V;
+        typedef __m128i I;
+        static const int width = 4;
+
+        static V load(const float* p) { return _mm_loadu_ps(p); }
+        static void store(float* p, const V& a) { _mm_storeu_ps(p, a); }
+        static V set1(const float& f) { return _mm_set1_ps(f); }
+
+        static V add(const V& a, const V& b) { return _mm_add_ps(a, b); }
+        static V sub(const V& a, const V& b) { return _mm_sub_ps(a, b); }
+        static V mul(const V& a, const V& b) { return _mm_mul_ps(a, b); }
+        static V div(const V& a, const V& b) { return _mm_div_ps(a, b); }
+        static V sqrt(const V& a) { return _mm_sqrt_ps(a); }
+        static V abs(const V& a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+        static V neg(const V& a) { return _mm_xor_ps(_mm_set1_ps(-0.0f), a); }
+
+        static V gt(const V& a, const V& b) { return _mm_cmpgt_ps(a, b); }
+        static V select(const V& mask, const V& a, const V& b) { return _mm_or_ps(_mm_and_ps(mask, a), _mm_andnot_ps(mask, b)); }
+        static int bits(const V& mask) { return _mm_movemask_ps(mask); }
+
+        static I roundToInt(const V& a) { return _mm_cvtps_epi32(a); }
+        static V toFloat(const I& j) { return _mm_cvtepi32_ps(j); }
+        static I addInt(const I& j, const int& k) { return _mm_add_epi32(j, _mm_set1_epi32(k)); }
+        static V hasBit(const I& j, const int& bit) {
+            __m128i b = _mm_set1_epi32(bit);
+            return _mm_castsi128_ps(_mm_cmpeq_epi32(_mm_and_si128(j, b), b));
+        }
+    };
+#endif
+
+#ifdef MATH_BATCH_AVX2
+    struct Avx {
+        typedef __m256 V;
+        typedef __m256i I;
+        static const int width = 8;
+
+        static V load(const float* p) { return _mm256_loadu_ps(p); }
+        static void store(float* p, const V& a) { _mm256_storeu_ps(p, a); }
+        static V set1(const float& f) { return _mm256_set1_ps(f); }
+
+        static V add(const V& a, const V& b) { return _mm256_add_ps(a, b); }
+        static V sub(const V& a, const V& b) { return _mm256_sub_ps(a, b); }
+        static V mul(const V& a, const V& b) { return _mm256_mul_ps(a, b); }
+        static V div(const V& a, const V& b) { return _mm256_div_ps(a, b); }
+        static V sqrt(const V& a) { return _mm256_sqrt_ps(a); }
+        static V abs(const V& a) { return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a); }
+        static V neg(const V& a) { return _mm256_xor_ps(_mm256_set1_ps(-0.0f), a); }
+
+        static V gt(const V& a, const V& b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+        static V select(const V& mask, const V& a, const V& b) { return _mm256_blendv_ps(b, a, mask); }
+        static int bits(const V& mask) { return _mm256_movemask_ps(mask); }
+
+        static I roundToInt(const V& a) { return _mm256_cvtps_epi32(a); }
+        static V toFloat(const I& j) { return _mm256_cvtepi32_ps(j); }
+        static I addInt(const I& j, const int& k) { return _mm256_add_epi32(j, _mm256_set1_epi32(k)); }
+        static V hasBit(const I& j, const int& bit) {
+            __m256i b = _mm256_set1_epi32(bit);
+            return _mm256_castsi256_ps(_mm256_cmpeq_epi32(_mm256_and_si256(j, b), b));
+        }
+    };
+#endif
+
+    ////////////////////////////////////
+    //// VECTORIZED TRANSCENDENTALS ////
+    ////////////////////////////////////
+
+    // sin and cos of the same argument (Cody-Waite reduction to [-pi/4,pi/4] followed by the Cephes minimax polynomials)
+    template <class S>
+    void sincos(const typename S::V& x, typename S::V& sinx, typename S::V& cosx) {
+        typedef typename S::V V;
+        typename S::I j = S::roundToInt(S::mul(x, S::set1(2 / M_PI)));
+        V jf = S::toFloat(j);
+        V r = S::sub(x, S::mul(jf, S::set1(1.5703125f)));
+        r = S::sub(r, S::mul(jf, S::set1(4.837512969970703125e-4f)));
+        r = S::sub(r, S::mul(jf, S::set1(7.549789948768648e-8f)));
+        V z = S::mul(r, r);
+
+        V s = S::add(S::mul(S::set1(-1.9515295891e-4f), z), S::set1(8.3321608736e-3f));
+        s = S::add(S::mul(s, z), S::set1(-1.6666654611e-1f));
+        s = S::add(S::mul(S::mul(s, z), r), r);
+
+        V c = S::add(S::mul(S::set1(2.443315711809948e-5f), z), S::set1(-1.388731625493765e-3f));
+        c = S::add(S::mul(c, z), S::set1(4.166664568298827e-2f));
+        c = S::add(S::sub(S::mul(S::mul(c, z), z), S::mul(S::set1(0.5f), z)), S::set1(1.0f));
+
+        // quadrant j%4 : sin = (s, c, -s, -c) and cos = (c, -s, -c, s)
+        V swap = S::hasBit(j, 1);
+        V sinr = S::select(swap, c, s);
+        V cosr = S::select(swap, s, c);
+        sinx = S::select(S::hasBit(j, 2), S::neg(sinr), sinr);
+        cosx = S::select(S::hasBit(S::addInt(j, 1), 2), S::neg(cosr), cosr);
+    }
+
+    /////////////////
+    //// KERNELS ////
+    /////////////////
+
+    // The reduction above loses accuracy as |x| grows, so lanes beyond this are redone with the scalar sin and cos
+    const float sincosRange = 8192;
+
+    template <class S>
+    void sincosKernel(const float* x, float* s, float* c, const int& i) {
+        typedef typename S::V V;
+        V xs = S::load(&x[i]);
+        V sinx, cosx;
+        sincos<S>(xs, sinx, cosx);
+        int far = S::bits(S::gt(S::abs(xs), S::set1(sincosRange)));
+        float lanes[S::width];
+        if (far != 0) S::store(lanes, xs);     // x may be s or c, which are about to be overwritten
+
+        S::store(&s[i], sinx);
+        S::store(&c[i], cosx);
+        for (int lane = 0; far != 0; lane++, far >>= 1) {
+            if (far & 1) {
+                s[i + lane] = sin(lanes[lane]);
+                c[i + lane] = cos(lanes[lane]);
+            }
+        }
+    }
+
+
+    template <class S>
+    void normalizeKernel(float* x, float* y, float* z, float* w, const int& i) {
+        typedef typename S::V V;
+        V qx = S::load(&x[i]), qy = S::load(&y[i]), qz = S::load(&z[i]), qw = S::load(&w[i]);
+        V norm = S::sqrt(S::add(S::add(S::mul(qx, qx), S::mul(qy, qy)), S::add(S::mul(qz, qz), S::mul(qw, qw))));
+        V inv = S::div(S::set1(1.0f), norm);
+        S::store(&x[i], S::mul(qx, inv));
+        S::store(&y[i], S::mul(qy, inv));
+        S::store(&z[i], S::mul(qz, inv));
+        S::store(&w[i], S::mul(qw, inv));
+    }
+
+}
+
+/////////////////////
+//// BATCHED API ////
+/////////////////////
+
+void Math::sincos(const float* x, float* s, float* c, const int& n) {
+    int i = 0;
+#ifdef MATH_BATCH_AVX2
+    for (; i + Avx::width <= n; i += Avx::width) sincosKernel<Avx>(x, s, c, i);
+#endif
+#ifdef MATH_BATCH_SSE2
+    for (; i + Sse::width <= n; i += Sse::width) sincosKernel<Sse>(x, s, c, i);
+#endif
+    for (; i < n; i++) {
+        float xi = x[i];
+        s[i] = sin(xi);
+        c[i] = cos(xi);
+    }
+}
+
+void Math::normalize(float* x, float* y, float* z, float* w, const int& n) {
+    int i = 0;
+#ifdef MATH_BATCH_AVX2
+    for (; i + Avx::width <= n; i += Avx::width) normalizeKernel<Avx>(x, y, z, w, i);
+#endif
+#ifdef MATH_BATCH_SSE2
+    for (; i + Sse::width <= n; i += Sse::width) normalizeKernel<Sse>(x, y, z, w, i);
+#endif
+    for (; i < n; i++) {
+        float inv = 1 / sqrt(x[i] * x[i] + y[i] * y[i] + z[i] * z[i] + w[i] * w[i]);
+        x[i] *= inv;
+        y[i] *= inv;
+        z[i] *= inv;
+        w[i] *= inv;
+    }
+}
\ No newline at end of file
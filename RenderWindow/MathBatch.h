@@ -0,0 +1,57 @@
+#ifndef _MATHBATCH_H_
+#define _MATHBATCH_H_
+
+#include "stdafx.h"
+#include "Math.h"
+
+// Structure-of-arrays batches of vectors and quaternions, and batch versions of the transcendentals behind the rotations
+// ... in Math.h. The kernels process 8 (AVX2) or 4 (SSE2) values per instruction where the compiler targets those
+// ... instruction sets, and fall back to the scalar routines for the remainder (or entirely, on other targets)
+// PoseBatch stores its poses in these batches, and turns socket parameters into rotations with the kernels
+// ... (see Socket::rotationsToJointFromParams)
+
+namespace Math {
+
+    class Vec3Batch
+    {
+    public:
+        Vec3Batch(const int& n = 0) : x(n), y(n), z(n) {}
+        Vec3Batch(const std::vector<glm::vec3>& vs);
+
+        int size() const { return x.size(); }
+        void resize(const int& n) { x.resize(n); y.resize(n); z.resize(n); }
+
+        glm::vec3 get(const int& i) const { return glm::vec3(x[i], y[i], z[i]); }
+        void set(const int& i, const glm::vec3& v) { x[i] = v[0]; y[i] = v[1]; z[i] = v[2]; }
+        std::vector<glm::vec3> unpack() const;
+
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> z;
+    };
+
+    class QuatBatch
+    {
+    public:
+        QuatBatch(const int& n = 0) : x(n), y(n), z(n), w(n, 1) {}
+
+        int size() const { return x.size(); }
+        void resize(const int& n) { x.resize(n); y.resize(n); z.resize(n); w.resize(n, 1); }
+
+        glm::quat get(const int& i) const { return glm::quat(w[i], x[i], y[i], z[i]); }
+        void set(const int& i, const glm::quat& q) { x[i] = q.x; y[i] = q.y; z[i] = q.z; w[i] = q.w; }
+
+        std::vector<float> x;
+        std::vector<float> y;
+        std::vector<float> z;
+        std::vector<float> w;
+    };
+
+    // s[i] = sin(x[i]) and c[i] = cos(x[i]) for i in [0, n). x may be the same buffer as s or c
+    void sincos(const float* x, float* s, float* c, const int& n);
+    // Scales each quaternion (x[i], y[i], z[i], w[i]) for i in [0, n) to unit length
+    void normalize(float* x, float* y, float* z, float* w, const int& n);
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,172 @@
+#include "Matrix.h"
+
+using namespace Math;
+
+void Math::multiply(const Matrix& A, const std::vector<float>& x, std::vector<float>& y) {
+    y.assign(A.rows(), 0);
+    for (int i = 0; i < A.rows(); i++) {
+        float sum = 0;
+        for (int j = 0; j < A.cols(); j++)
+            sum += A(i, j)*x[j];
+        y[i] = sum;
+    }
+}
+
+void Math::multiplyTransposed(const Matrix& A, const std::vector<float>& x, std::vector<float>& y) {
+    y.assign(A.cols(), 0);
+    for (int i = 0; i < A.rows(); i++) {
+        if (x[i] == 0) continue;
+        for (int j = 0; j < A.cols(); j++)
+            y[j] += A(i, j)*x[i];
+    }
+}
+
+void Math::outerGram(const Matrix& A, Matrix& AAt) {
+    int n = A.rows();
+    AAt.resize(n, n);
+    for (int i = 0; i < n; i++) {
+        for (int j = 0; j <= i; j++) {
+            float sum = 0;
+            for (int k = 0; k < A.cols(); k++)
+                sum += A(i, k)*A(j, k);
+            AAt(i, j) = sum;
+            AAt(j, i) = sum;
+        }
+    }
+}
+
+void Math::symmetricEigen(const Matrix& Ain, std::vector<float>& values, Matrix& V, const int& maxSweeps) {
+    int n = Ain.rows();
+    Matrix A = Ain;
+    V.resize(n, n);
+    for (int i = 0; i < n; i++) V(i, i) = 1;
+
+    for (int sweep = 0; sweep < maxSweeps; sweep++) {
+        float offDiagonal = 0;
+        float diagonal = 0;
+        for (int p = 0; p < n; p++) {
+            diagonal += A(p, p)*A(p, p);
+            for (int q = p + 1; q < n; q++)
+                offDiagonal += A(p, q)*A(p, q);
+        }
+        if (offDiagonal <= 1e-12f*diagonal) break;
+
+        for (int p = 0; p < n; p++) {
+            for (int q = p + 1; q < n; q++) {
+                if (A(p, q) == 0) continue;
+
+                // the rotation (c, s) in the (p, q) plane that zeroes A(p, q)
+                float tau = (A(q, q) - A(p, p)) / (2 * A(p, q));
+                float t = ((tau >= 0) ? 1.0f : -1.0f) / (fabs(tau) + sqrt(1 + tau*tau));
+                float c = 1 / sqrt(1 + t*t);
+                float s = t*c;
+
+                for (int k = 0; k < n; k++) {
+                    float akp = A(k, p);
+                    float akq = A(k, q);
+                    A(k, p) = c*akp - s*akq;
+                    A(k, q) = s*akp + c*akq;
+                }
+                for (int k = 0; k < n; k++) {
+                    float apk = A(p, k);
+                    float aqk = A(q, k);
+                    A(p, k) = c*apk - s*aqk;
+                    A(q, k) = s*apk + c*aqk;
+                }
+                for (int k = 0; k < n; k++) {
+                    float vkp = V(k, p);
+                    float vkq = V(k, q);
+                    V(k, p) = c*vkp - s*vkq;
+                    V(k, q) = s*vkp + c*vkq;
+                }
+            }
+        }
+    }
+
+    values.resize(n);
+    for (int i = 0; i < n; i++) values[i] = A(i, i);
+}
+
+bool Math::choleskySolve(Matrix& A, std::vector<float>& b) {
+    int n = A.rows();
+
+    // A = L*L^T, with L stored in the lower triangle of A
+    for (int j = 0; j < n; j++) {
+        float d = A(j, j);
+        for (int k = 0; k < j; k++)
+            d -= A(j, k)*A(j, k);
+        if (!(d > 0)) return false;
+        d = sqrt(d);
+        A(j, j) = d;
+        for (int i = j + 1; i < n; i++) {
+            float sum = A(i, j);
+            for (int k = 0; k < j; k++)
+                sum -= A(i, k)*A(j, k);
+            A(i, j) = sum / d;
+        }
+    }
+
+    // L*y = b, then L^T*x = y
+    for (int i = 0; i < n; i++) {
+        float sum = b[i];
+        for (int k = 0; k < i; k++)
+            sum -= A(i, k)*b[k];
+        b[i] = sum / A(i, i);
+    }
+    for (int i = n - 1; i >= 0; i--) {
+        float sum = b[i];
+        for (int k = i + 1; k < n; k++)
+            sum -= A(k, i)*b[k];
+        b[i] = sum / A(i, i);
+    }
+    return true;
+}
+
+TreeSymmetricMatrix::TreeSymmetricMatrix(const std::vector<int>& parents) :
+_parents(parents), _depths(parents.size(), 0), _entries(parents.size())
+{
+    int n = (int)_parents.size();
+    for (int j = 0; j < n; j++) {
+        if (_parents[j] >= 0) _depths[j] = _depths[_parents[j]] + 1;
+        _entries[j].assign(_depths[j] + 1, 0);
+    }
+}
+
+void TreeSymmetricMatrix::setZero() {
+    for (auto& column : _entries)
+        std::fill(column.begin(), column.end(), 0.0f);
+}
+
+bool TreeSymmetricMatrix::choleskySolve(std::vector<float>& b) {
+    int n = size();
+
+    // A = L*L^T eliminating from the last column back: column j of L only has entries at j and its ancestors
+    // ... and removing it only touches the entries between pairs of those ancestors, which are all in the pattern
+    for (int j = n - 1; j >= 0; j--) {
+        std::vector<float>& column = _entries[j];
+        float d = column[_depths[j]];
+        if (!(d > 0)) return false;
+        d = sqrt(d);
+        column[_depths[j]] = d;
+        for (int a = _parents[j]; a >= 0; a = _parents[a])
+            column[_depths[a]] /= d;
+        for (int a = _parents[j]; a >= 0; a = _parents[a]) {
+            float la = column[_depths[a]];
+            for (int c = a; c >= 0; c = _parents[c])
+                _entries[a][_depths[c]] -= la*column[_depths[c]];
+        }
+    }
+
+    // L*y = b in the same order, then L^T*x = y back from the roots
+    for (int j = n - 1; j >= 0; j--) {
+        b[j] /= _entries[j][_depths[j]];
+        for (int a = _parents[j]; a >= 0; a = _parents[a])
+            b[a] -= _entries[j][_depths[a]]*b[j];
+    }
+    for (int j = 0; j < n; j++) {
+        for (int a = _parents[j]; a >= 0; a = _parents[a])
+            b[j] -= _entries[j][_depths[a]]*b[a];
+        b[j] /= _entries[j][_depths[j]];
+    }
+    return true;
+}
\ No newline at end of file
@@ -0,0 +1,76 @@
+#ifndef _MATRIX_H_
+#define _MATRIX_H_
+
+#include "stdafx.h"
+
+// Small dense matrices for the IK solvers
+// The systems they solve are a handful of rows by a few dozen parameters, so plain row-major storage and textbook
+// ... factorizations are all that is needed (and keep armadillo out of the hot path)
+
+namespace Math {
+
+    class Matrix
+    {
+    public:
+        Matrix(const int& rows = 0, const int& cols = 0) : _rows(rows), _cols(cols), _data(rows*cols, 0) {}
+
+        int rows() const { return _rows; }
+        int cols() const { return _cols; }
+
+        // Resizing zeroes every entry, but keeps the allocation when it is large enough
+        void resize(const int& rows, const int& cols) { _rows = rows; _cols = cols; _data.assign(rows*cols, 0); }
+        void setZero() { std::fill(_data.begin(), _data.end(), 0.0f); }
+
+        float& operator()(const int& row, const int& col) { return _data[row*_cols + col]; }
+        const float& operator()(const int& row, const int& col) const { return _data[row*_cols + col]; }
+
+    private:
+        int _rows;
+        int _cols;
+        std::vector<float> _data;
+    };
+
+    // Symmetric matrix whose sparsity follows a forest over its columns: off the diagonal, (i, j) can only be nonzero
+    // ... if one of i and j is an ancestor of the other (reached by following parents, and every parent comes before its children)
+    // The normal equations J^T J of IK paths that all leave from one root have this shape, and a Cholesky factorization
+    // ... that eliminates the leaves first creates no fill-in: it costs the sum of the squared depths of the columns, not n^3
+    class TreeSymmetricMatrix
+    {
+    public:
+        TreeSymmetricMatrix(const std::vector<int>& parents = std::vector<int>());
+
+        int size() const { return _parents.size(); }
+        int parent(const int& i) const { return _parents[i]; }
+        void setZero();
+
+        // Entry (i, j) where i is j itself or one of its ancestors
+        float& operator()(const int& i, const int& j) { return _entries[j][_depths[i]]; }
+        const float& operator()(const int& i, const int& j) const { return _entries[j][_depths[i]]; }
+
+        // Solves A*x = b in place (b becomes x), overwriting A with its Cholesky factor
+        // Returns false (with b left half solved) if A turns out not to be positive definite
+        bool choleskySolve(std::vector<float>& b);
+
+    private:
+        std::vector<int> _parents;
+        std::vector<int> _depths;
+        std::vector<std::vector<float>> _entries;   // _entries[j][depth of i] = A(i, j) for i = j and each ancestor i of j
+    };
+
+    // y = A*x and y = A^T*x
+    void multiply(const Matrix& A, const std::vector<float>& x, std::vector<float>& y);
+    void multiplyTransposed(const Matrix& A, const std::vector<float>& x, std::vector<float>& y);
+    // AAt = A*A^T
+    void outerGram(const Matrix& A, Matrix& AAt);
+
+    // Eigen-decomposition of a symmetric matrix by cyclic Jacobi rotations: A = V*diag(values)*V^T
+    // The eigenvectors are the columns of V
+    void symmetricEigen(const Matrix& A, std::vector<float>& values, Matrix& V, const int& maxSweeps = 16);
+
+    // Solves A*x = b in place (b becomes x) for a symmetric positive definite A, which is overwritten by its Cholesky factor
+    // Returns false (leaving b untouched) if A turns out not to be positive definite
+    bool choleskySolve(Matrix& A, std::vector<float>& b);
+
+}
+
+#endif
\ No newline at end of file
@@ -0,0 +1,154 @@
+#include "PoseBatch.h"
+
+using namespace Scene;
+
+namespace {
+    // out[p] = parent[p] * local[p] for every pose p, with the 7 floats of each transform (translation, quaternion) in arrays
+    // ... of their own: parent and out are the rows of two components (which never overlap), and the local transform is
+    // ... either the same for all poses (a rigid edge, read from element 0) or one per pose (a coupling)
+    // Every array is unit-stride and restrict-qualified, so that the compiler vectorizes the loop across poses
+    // ... which is why the quaternions are left for Math::normalize (sqrt keeps the loop scalar wherever it may set errno)
+    template <bool perPose>
+    void compose(const int n,
+        const float* __restrict tx, const float* __restrict ty, const float* __restrict tz,
+        const float* __restrict qx, const float* __restrict qy, const float* __restrict qz, const float* __restrict qw,
+        const float* __restrict ltx, const float* __restrict lty, const float* __restrict ltz,
+        const float* __restrict lqx, const float* __restrict lqy, const float* __restrict lqz, const float* __restrict lqw,
+        float* __restrict txOut, float* __restrict tyOut, float* __restrict tzOut,
+        float* __restrict qxOut, float* __restrict qyOut, float* __restrict qzOut, float* __restrict qwOut)
+    {
+        for (int p = 0; p < n; p++) {
+            int l = perPose ? p : 0;
+            float vx = ltx[l], vy = lty[l], vz = ltz[l];
+
+            // rotate the local translation by the parent's quaternion: v + 2*u x (u x v + w*v)
+            float cx = qy[p] * vz - qz[p] * vy + qw[p] * vx;
+            float cy = qz[p] * vx - qx[p] * vz + qw[p] * vy;
+            float cz = qx[p] * vy - qy[p] * vx + qw[p] * vz;
+            txOut[p] = tx[p] + vx + 2 * (qy[p] * cz - qz[p] * cy);
+            tyOut[p] = ty[p] + vy + 2 * (qz[p] * cx - qx[p] * cz);
+            tzOut[p] = tz[p] + vz + 2 * (qx[p] * cy - qy[p] * cx);
+
+            float rx = lqx[l], ry = lqy[l], rz = lqz[l], rw = lqw[l];
+            qxOut[p] = qw[p] * rx + qx[p] * rw + qy[p] * rz - qz[p] * ry;
+            qyOut[p] = qw[p] * ry + qy[p] * rw + qz[p] * rx - qx[p] * rz;
+            qzOut[p] = qw[p] * rz + qz[p] * rw + qx[p] * ry - qy[p] * rx;
+            qwOut[p] = qw[p] * rw - qx[p] * rx - qy[p] * ry - qz[p] * rz;
+        }
+    }
+
+    // The coupling seen from the joint's side for every pose: q becomes its inverse, and t = -(q^-1 * tToJoint)
+    void invertCouplings(const int n, const glm::vec3& tToJoint,
+        float* __restrict qx, float* __restrict qy, float* __restrict qz, const float* __restrict qw,
+        float* __restrict tx, float* __restrict ty, float* __restrict tz)
+    {
+        float vx = tToJoint[0], vy = tToJoint[1], vz = tToJoint[2];
+        for (int p = 0; p < n; p++) {
+            float ux = -qx[p], uy = -qy[p], uz = -qz[p];
+            float cx = uy * vz - uz * vy + qw[p] * vx;
+            float cy = uz * vx - ux * vz + qw[p] * vy;
+            float cz = ux * vy - uy * vx + qw[p] * vz;
+            tx[p] = -(vx + 2 * (uy * cz - uz * cy));
+            ty[p] = -(vy + 2 * (uz * cx - ux * cz));
+            tz[p] = -(vz + 2 * (ux * cy - uy * cx));
+            qx[p] = ux;
+            qy[p] = uy;
+            qz[p] = uz;
+        }
+    }
+}
+
+PoseBatch::PoseBatch(const FlatSkeleton* skeleton, const int& nPoses) :
+_skeleton(skeleton), _nPoses(nPoses),
+_globalTranslations(skeleton->size()*nPoses), _globalQuaternions(skeleton->size()*nPoses),
+_localTranslations(nPoses), _localQuaternions(nPoses)
+{
+    const std::vector<float>& params = skeleton->params();
+    int nParams = params.size();
+    _params.resize(nParams*nPoses);
+    for (int j = 0; j < nParams; j++)
+        for (int p = 0; p < nPoses; p++)
+            _params[j*nPoses + p] = params[j];
+
+    _couplingSlots.assign(skeleton->size(), -1);
+    const std::vector<int>& couplings = skeleton->couplings();
+    int nCouplings = couplings.size();
+    for (int k = 0; k < nCouplings; k++)
+        _couplingSlots[couplings[k]] = k;
+}
+
+void PoseBatch::setPose(const int& pose, const std::vector<float>& params) {
+    int nParams = params.size();
+    for (int j = 0; j < nParams; j++)
+        _params[j*_nPoses + pose] = params[j];
+}
+
+std::vector<float> PoseBatch::pose(const int& pose) const {
+    int nParams = _params.size() / std::max(_nPoses, 1);
+    std::vector<float> params(nParams);
+    for (int j = 0; j < nParams; j++)
+        params[j] = _params[j*_nPoses + pose];
+    return params;
+}
+
+void PoseBatch::buildCouplings(const int& k) {
+    // Fills the scratch buffers with the transform across coupling k, from the parent's side, for every pose
+    int i = _skeleton->couplings()[k];
+    Socket* socket = _skeleton->sockets()[k];
+    bool fromSocket = _skeleton->component(_skeleton->parent(i)) == socket;
+    glm::vec3 tToJoint = socket->translationToJoint();
+
+    int offset = _skeleton->paramOffset(k);
+    int nParams = _skeleton->nParams(k);
+    _paramRows.resize(nParams);
+    for (int j = 0; j < nParams; j++)
+        _paramRows[j] = &_params[(offset + j)*_nPoses];
+    socket->rotationsToJointFromParams(_paramRows.data(), _nPoses, _localQuaternions, _scratchParams);
+
+    Math::Vec3Batch& t = _localTranslations;
+    Math::QuatBatch& q = _localQuaternions;
+    if (fromSocket) {
+        std::fill(t.x.begin(), t.x.end(), tToJoint[0]);
+        std::fill(t.y.begin(), t.y.end(), tToJoint[1]);
+        std::fill(t.z.begin(), t.z.end(), tToJoint[2]);
+    }
+    else invertCouplings(_nPoses, tToJoint, q.x.data(), q.y.data(), q.z.data(), q.w.data(), t.x.data(), t.y.data(), t.z.data());
+}
+
+void PoseBatch::forwardKinematics() {
+    int n = _skeleton->size();
+    if (n == 0 || _nPoses == 0) return;
+
+    RigidTransform root = _skeleton->component(0)->globalTransform();
+    for (int p = 0; p < _nPoses; p++) {
+        _globalTranslations.set(p, root.translation());
+        _globalQuaternions.set(p, root.quaternion());
+    }
+
+    Math::Vec3Batch& t = _globalTranslations;
+    Math::QuatBatch& q = _globalQuaternions;
+    for (int i = 1; i < n; i++) {
+        int a = _skeleton->parent(i)*_nPoses;
+        int b = i*_nPoses;
+        int k = _couplingSlots[i];
+        if (k < 0) {
+            const RigidTransform& local = _skeleton->local(i);
+            glm::vec3 lt = local.translation();
+            glm::quat lq = local.quaternion();
+            compose<false>(_nPoses,
+                &t.x[a], &t.y[a], &t.z[a], &q.x[a], &q.y[a], &q.z[a], &q.w[a],
+                &lt[0], &lt[1], &lt[2], &lq.x, &lq.y, &lq.z, &lq.w,
+                &t.x[b], &t.y[b], &t.z[b], &q.x[b], &q.y[b], &q.z[b], &q.w[b]);
+        }
+        else {
+            buildCouplings(k);
+            const Math::Vec3Batch& lt = _localTranslations;
+            const Math::QuatBatch& lq = _localQuaternions;
+            compose<true>(_nPoses,
+                &t.x[a], &t.y[a], &t.z[a], &q.x[a], &q.y[a], &q.z[a], &q.w[a],
+                lt.x.data(), lt.y.data(), lt.z.data(), lq.x.data(), lq.y.data(), lq.z.data(), lq.w.data(),
+                &t.x[b], &t.y[b], &t.z[b], &q.x[b], &q.y[b], &q.z[b], &q.w[b]);
+        }
+        Math::normalize(&q.x[b], &q.y[b], &q.z[b], &q.w[b], _nPoses);
+    }
+}
\ No newline at end of file
@@ -0,0 +1,66 @@
+#ifndef _POSEBATCH_H_
+#define _POSEBATCH_H_
+
+#include "stdafx.h"
+#include "FlatSkeleton.h"
+#include "MathBatch.h"
+
+namespace Scene {
+
+    // Forward kinematics for many poses (sets of socket parameters) of the same FlatSkeleton at once
+    // ... the poses live in buffers of their own, so the components (and their backups) are never touched
+    //
+    // Everything is stored interleaved per component: the entry for pose p of component (or parameter) i sits at i*nPoses() + p
+    // ... so that the inner loops run over contiguous floats and the compiler can vectorize them
+    //
+    // A building block for callers that evaluate many candidate poses (e.g. sampling or population based solvers)
+    // ... none of the solvers in IKSolvers.h uses it yet, since each of them steps a single pose of the skeleton
+
+    class PoseBatch
+    {
+    public:
+        PoseBatch(const FlatSkeleton* skeleton, const int& nPoses);
+
+        // The parameters of every pose are laid out like FlatSkeleton::params(), and start out as the skeleton's current ones
+        void setPose(const int& pose, const std::vector<float>& params);
+        std::vector<float> pose(const int& pose) const;
+        void setParam(const int& pose, const int& j, const float& value) { _params[j*_nPoses + pose] = value; }
+        float param(const int& pose, const int& j) const { return _params[j*_nPoses + pose]; }
+
+        // Recomputes the global transforms of every component in every pose, with the skeleton's root held where it is now
+        void forwardKinematics();
+
+        /////////////////
+        //// GETTERS ////
+        /////////////////
+
+        const FlatSkeleton* skeleton() const { return _skeleton; }
+        int nPoses() const { return _nPoses; }
+
+        glm::vec3 globalTranslation(const int& pose, const int& i) const { return _globalTranslations.get(i*_nPoses + pose); }
+        glm::quat globalQuaternion(const int& pose, const int& i) const { return _globalQuaternions.get(i*_nPoses + pose); }
+        RigidTransform globalTransform(const int& pose, const int& i) const {
+            return RigidTransform(globalTranslation(pose, i), globalQuaternion(pose, i));
+        }
+
+    private:
+        void buildCouplings(const int& k);
+
+        const FlatSkeleton* _skeleton;
+        int _nPoses;
+
+        std::vector<float> _params;
+        std::vector<int> _couplingSlots;            // per component, index into the skeleton's couplings() (-1 for other edges)
+
+        Math::Vec3Batch _globalTranslations;
+        Math::QuatBatch _globalQuaternions;
+
+        Math::Vec3Batch _localTranslations;         // scratch: the local transforms across one coupling, for every pose
+        Math::QuatBatch _localQuaternions;
+        std::vector<const float*> _paramRows;       // scratch: where each parameter of one coupling starts in _params
+        std::vector<float> _scratchParams;
+    };
+
+}
+
+#endif
\ No newline at end of file
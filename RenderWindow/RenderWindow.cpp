@@ -12,6 +12,7 @@ Scene::Body* body;
 Scene::Bone* bone;
 
 void idle(void) {
+    body->beginFrame();
     body->setTranslation(bone, tipPath->stepT(0.005f));
     glutPostRedisplay();
 }
@@ -0,0 +1,45 @@
+#ifndef _RIGIDTRANSFORM_H_
+#define _RIGIDTRANSFORM_H_
+
+#include "stdafx.h"
+#include "Math.h"
+
+// A rotation followed by a translation, i.e. x -> R*x + t
+// The rotation is held both as a unit quaternion (for composition) and as a matrix (for applying it to vectors)
+// ... and the two are always kept in sync, so consumers never have to rebuild the matrix from axis-angle
+
+class RigidTransform
+{
+public:
+    RigidTransform() : _t(glm::vec3(0, 0, 0)), _q(glm::quat()), _R(glm::mat3()) {}
+    RigidTransform(const glm::vec3& t, const glm::vec3& w) : _t(t), _q(Math::q(w)), _R(Math::R(_q)) {}
+    RigidTransform(const glm::vec3& t, const glm::quat& q) : _t(t), _q(q), _R(Math::R(q)) {}
+
+    glm::vec3 translation() const { return _t; }
+    glm::vec3 rotation() const { return Math::w(_q); }
+    glm::quat quaternion() const { return _q; }
+    glm::mat3 rotationMatrix() const { return _R; }
+
+    void setTranslation(const glm::vec3& t) { _t = t; }
+    void setRotation(const glm::vec3& w) { setRotation(Math::q(w)); }
+    void setRotation(const glm::quat& q) { _q = q; _R = Math::R(q); }
+
+    glm::vec3 apply(const glm::vec3& x) const { return _R*x + _t; }
+    glm::vec3 applyRotation(const glm::vec3& v) const { return _R*v; }
+
+    // Composes a transform expressed in the frame of this one (same convention as TransformStack in LOCAL mode)
+    RigidTransform operator*(const RigidTransform& local) const {
+        return RigidTransform(_t + _R*local._t, glm::normalize(_q*local._q));
+    }
+    RigidTransform inverse() const {
+        glm::quat qInverse = glm::conjugate(_q);
+        return RigidTransform(-(glm::transpose(_R)*_t), qInverse);
+    }
+
+private:
+    glm::vec3 _t;
+    glm::quat _q;
+    glm::mat3 _R;
+};
+
+#endif
\ No newline at end of file
@@ -5,6 +5,7 @@ using namespace glm;
 using namespace Math;
 using namespace Scene;
 
+int SkeletonComponent::_topologyVersion = 0;
 
 std::map<SkeletonComponent*, std::pair<glm::vec3, glm::vec3>> SkeletonComponent::transformsToConnectedComponents() const {
     std::map<SkeletonComponent*, std::pair<glm::vec3, glm::vec3>> map;
@@ -28,56 +29,81 @@ std::map<SkeletonComponent*, std::pair<glm::vec3, glm::vec3>> SkeletonComponent:
     return map;
 }
 
+bool SkeletonComponent::transformToConnectedComponent(SkeletonComponent* component, glm::vec3& t, glm::vec3& w) const {
+    if (component == NULL) return false;
+    if (const Bone* bone = dynamic_cast<const Bone*>(this)) {
+        Connection* connection = dynamic_cast<Connection*>(component);
+        if (connection == NULL || connection->bone() != bone) return false;
+        t = connection->translationFromBone();
+        w = connection->rotationFromBone();
+        return true;
+    }
+    else if (const Connection* connection = dynamic_cast<const Connection*>(this)) {
+        if (component == connection->bone()) {
+            t = connection->translationToBone();
+            w = connection->rotationToBone();
+            return true;
+        }
+        else if (component == connection->opposingConnection()) {
+            t = connection->translationToOpposingConnection();
+            w = connection->rotationToOpposingConnection();
+            return true;
+        }
+    }
+    return false;
+}
+
 void SkeletonComponent::localUpdateGlobalTranslation(const glm::vec3& tGlobal) {
-    _tGlobal = tGlobal;
+    _global.setTranslation(tGlobal);
+    glm::mat3 RGlobal = _global.rotationMatrix();
     if (Connection* connection = dynamic_cast<Connection*>(this)) {
         Bone* anchor = connection->bone();
         if (anchor != NULL) {
-            glm::mat3 RGlobal = Math::R(_wGlobal);
             glm::mat3 StandardToAnchor = RGlobal*Math::R(RGlobal*(-connection->rotationFromBone()));
-            anchor->_tGlobal = tGlobal + StandardToAnchor*(-connection->translationFromBone());
+            anchor->setGlobalTranslation(tGlobal + StandardToAnchor*(-connection->translationFromBone()));
         }
     }
     if (Bone* bone = dynamic_cast<Bone*>(this)) {
         for (auto connection : bone->connections()) {
-            connection->_tGlobal = tGlobal + Math::rotate(connection->translationFromBone(), _wGlobal);
+            connection->setGlobalTranslation(tGlobal + RGlobal*connection->translationFromBone());
         }
     }
 }
 
 void SkeletonComponent::localUpdateGlobalRotation(const glm::vec3& wGlobal) {
-    _wGlobal = wGlobal;
+    setGlobalRotation(wGlobal);
+    glm::mat3 RGlobal = _global.rotationMatrix();
     if (Connection* connection = dynamic_cast<Connection*>(this)) {
         Bone* anchor = connection->bone();
         if (anchor != NULL) {
-            glm::mat3 RGlobal = Math::R(wGlobal);
             glm::mat3 StandardToAnchor = RGlobal*Math::R(RGlobal*(-connection->rotationFromBone()));
-            anchor->_wGlobal = Math::w(StandardToAnchor);
+            anchor->setGlobalRotation(Math::q(StandardToAnchor));
         }
     }
     if (Bone* bone = dynamic_cast<Bone*>(this)) {
         for (auto connection : bone->connections()) {
-            connection->_wGlobal = Math::R(wGlobal)*Math::rotate(connection->rotationFromBone(), wGlobal);
+            connection->setGlobalRotation(RGlobal*(RGlobal*connection->rotationFromBone()));
         }
     }
 }
 
 void SkeletonComponent::localUpdateGlobalTranslationAndRotation(const glm::vec3& tGlobal, const glm::vec3& wGlobal) {
-    _wGlobal = wGlobal;
-    _tGlobal = tGlobal;
+    setGlobalRotation(wGlobal);
+    _global.setTranslation(tGlobal);
+    glm::mat3 RGlobal = _global.rotationMatrix();
     if (Connection* connection = dynamic_cast<Connection*>(this)) {
         Bone* anchor = connection->bone();
         if (anchor != NULL) {
-            glm::mat3 RGlobal = Math::R(wGlobal);
             glm::mat3 StandardToAnchor = RGlobal*Math::R(RGlobal*(-connection->rotationFromBone()));
-            anchor->_wGlobal = Math::w(StandardToAnchor);
-            anchor->_tGlobal = tGlobal + StandardToAnchor*(-connection->translationFromBone());
+            anchor->setGlobalTransform(RigidTransform(
+                tGlobal + StandardToAnchor*(-connection->translationFromBone()), Math::q(StandardToAnchor)));
+            anchor->markDirty();
         }
     }
     if (Bone* bone = dynamic_cast<Bone*>(this)) {
         for (auto connection : bone->connections()) {
-            connection->_wGlobal = Math::R(wGlobal)*Math::rotate(connection->rotationFromBone(), wGlobal);
-            connection->_tGlobal = tGlobal + Math::rotate(connection->translationFromBone(), wGlobal);
+            connection->setGlobalRotation(RGlobal*(RGlobal*connection->rotationFromBone()));
+            connection->setGlobalTranslation(tGlobal + RGlobal*connection->translationFromBone());
         }
     }
 }
@@ -159,4 +185,30 @@ TreeNode<SkeletonComponent*>* SkeletonComponent::buildTreeTowards(std::set<Skele
     } while (stack.size() > 0);
 
     return root;
+}
+
+UpdatePlan SkeletonComponent::buildUpdatePlan() {
+    UpdatePlan plan;
+
+    std::vector<std::pair<SkeletonComponent*, int>> stack({ std::make_pair(this, -1) });
+    std::set<SkeletonComponent*> visited({ this });
+
+    SkeletonComponent* component;
+    int parent;
+    do {
+        std::tie(component, parent) = stack.back();
+        stack.pop_back();
+
+        int i = plan.components.size();
+        plan.components.push_back(component);
+        plan.parents.push_back(parent);
+
+        for (auto neighbor : component->connectedComponents()) {
+            if (neighbor == NULL || visited.find(neighbor) != visited.end()) continue;
+            visited.insert(neighbor);
+            stack.push_back(std::make_pair(neighbor, i));
+        }
+    } while (stack.size() > 0);
+
+    return plan;
 }
\ No newline at end of file
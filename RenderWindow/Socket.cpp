@@ -54,12 +54,14 @@ void Socket::setParams(const std::map<int, float>& params_unconstrained) {
     _params = params_unconstrained;
     constrainParams();
     buildTransformsFromParams();
+    markDirty();
 }
 void Socket::setParam(const int& key, const float& value) {
     if (opposingBone() == NULL) return;
     _params[key] = value;
     constrainParams();
     buildTransformsFromParams();
+    markDirty();
 }
 
 Joint* Socket::couple(Joint* joint) {
@@ -74,6 +76,9 @@ Joint* Socket::couple(Joint* joint) {
         }
         joint->_socket = this;
         _joint = joint;
+        markDirty();
+        joint->markDirty();
+        touchTopology();
     }
     return joint;
 }
@@ -85,7 +90,10 @@ void Socket::decouple() {
             bone->_sockets.insert(this);        // 3: Reattach this socket to its anchor without skeleton updates
         }
         _joint->_socket = NULL;                 // 4: Sever the socket-joint link
+        _joint->markDirty();                    //    ...
         _joint = NULL;                          //    ...
+        markDirty();
+        touchTopology();
     }
 }
 
@@ -95,6 +103,7 @@ void Socket::setTranslationToJoint(const glm::vec3& translation) {
     buildParamsFromTransforms();
     constrainParams();
     buildTransformsFromParams();
+    markDirty();
 }
 void Socket::setRotationToJoint(const glm::vec3& w) {
     if (opposingBone() == NULL) return;
@@ -102,26 +111,39 @@ void Socket::setRotationToJoint(const glm::vec3& w) {
     buildParamsFromTransforms();
     constrainParams();
     buildTransformsFromParams();
+    markDirty();
 }
 
 void Socket::setConstraint(const int& key, const float& value) {
     _constraints[key] = value;
     constrainParams();
     buildTransformsFromParams();
+    markDirty();
 }
 
 bool Socket::transformAnchorToTarget(glm::vec3& t, glm::vec3& w) const {
     if (opposingBone() == NULL) return false;
 
-    std::vector<std::pair<glm::vec3, glm::vec3>> localTransforms(4);
+    std::array<std::pair<glm::vec3, glm::vec3>, 4> localTransforms;
     localTransforms[0] = std::make_pair(_tFromBone, _wFromBone);
     localTransforms[1] = std::make_pair(_tToJoint, _wToJoint);
     localTransforms[2] = std::make_pair(glm::vec3(0, 0, 0), glm::vec3(0, M_PI, 0));
     localTransforms[3] = std::make_pair(Math::rotate(-_joint->_tFromBone, -_joint->_wFromBone), -_joint->_wFromBone);
 
-    std::pair<glm::vec3, glm::vec3> tw = Math::composeLocalTransforms(localTransforms).back();
+    std::pair<glm::vec3, glm::vec3> tw = Math::composeAllLocalTransforms(localTransforms);
     t = tw.first;
     w = tw.second;
     return true;
 }
 
+void Socket::rotationsToJointFromParams(const float* const* params, const int& n, Math::QuatBatch& q,
+    std::vector<float>& scratch) const
+{
+    int nParams = _params.size();
+    scratch.resize(nParams);
+    for (int p = 0; p < n; p++) {
+        for (int j = 0; j < nParams; j++)
+            scratch[j] = params[j][p];
+        q.set(p, rotationToJointFromParams(scratch.data()));
+    }
+}
\ No newline at end of file
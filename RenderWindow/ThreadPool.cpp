@@ -0,0 +1,103 @@
+#include "ThreadPool.h"
+
+namespace {
+    // Identifies the pool and queue a thread works on (NULL / -1 for threads outside any pool)
+    thread_local const ThreadPool* currentPool = NULL;
+    thread_local int currentQueue = -1;
+}
+
+ThreadPool::ThreadPool(const int& nThreads) : _queued(0), _nextQueue(0), _stop(false) {
+    int n = std::max(nThreads, 1);
+    for (int i = 0; i < n; i++)
+        _queues.push_back(new Queue());
+    for (int i = 0; i < n; i++)
+        _workers.push_back(std::thread(&ThreadPool::work, this, i));
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _stop = true;
+    }
+    _wake.notify_all();
+    for (auto& worker : _workers)
+        worker.join();
+    for (auto queue : _queues)
+        delete queue;
+}
+
+void ThreadPool::submit(TaskGroup& group, const std::function<void()>& task) {
+    group._pending++;
+
+    int i = (currentPool == this) ? currentQueue : (_nextQueue++ % (int)_queues.size());
+    {
+        // Counted in the same critical section as the push, so the runner taking it (which uncounts it under _sleepMutex)
+        // ... can't get there first
+        std::lock_guard<std::mutex> sleepLock(_sleepMutex);
+        std::lock_guard<std::mutex> lock(_queues[i]->mutex);
+        Task newTask = { task, &group };
+        _queues[i]->tasks.push_back(newTask);
+        _queued++;
+    }
+    _wake.notify_one();
+}
+
+void ThreadPool::wait(TaskGroup& group) {
+    int i = (currentPool == this) ? currentQueue : 0;
+    while (group._pending > 0) {
+        if (runOne(i)) continue;
+        // Sleeps until there is a task to help with or the group's last one is done
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        _wake.wait(lock, [this, &group]() { return _stop || _queued > 0 || group._pending == 0; });
+    }
+}
+
+void ThreadPool::work(const int& i) {
+    currentPool = this;
+    currentQueue = i;
+    while (true) {
+        if (runOne(i)) continue;
+        std::unique_lock<std::mutex> lock(_sleepMutex);
+        _wake.wait(lock, [this]() { return _stop || _queued > 0; });
+        if (_stop) return;
+    }
+}
+
+bool ThreadPool::runOne(const int& i) {
+    Task task;
+    if (!pop(i, task) && !steal(i, task)) return false;
+    {
+        std::lock_guard<std::mutex> lock(_sleepMutex);
+        _queued--;
+    }
+    task.run();
+    // Under _sleepMutex, so a wait() between checking the group and sleeping can't miss the wake-up
+    std::unique_lock<std::mutex> lock(_sleepMutex);
+    if (--task.group->_pending == 0) {
+        lock.unlock();
+        _wake.notify_all();
+    }
+    return true;
+}
+
+bool ThreadPool::pop(const int& i, Task& task) {
+    Queue* queue = _queues[i];
+    std::lock_guard<std::mutex> lock(queue->mutex);
+    if (queue->tasks.empty()) return false;
+    task = queue->tasks.back();
+    queue->tasks.pop_back();
+    return true;
+}
+
+bool ThreadPool::steal(const int& i, Task& task) {
+    int n = _queues.size();
+    for (int k = 1; k < n; k++) {
+        Queue* queue = _queues[(i + k) % n];
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        if (queue->tasks.empty()) continue;
+        task = queue->tasks.front();
+        queue->tasks.pop_front();
+        return true;
+    }
+    return false;
+}
\ No newline at end of file
@@ -0,0 +1,63 @@
+#ifndef _THREADPOOL_H_
+#define _THREADPOOL_H_
+
+#include "stdafx.h"
+
+// A fixed set of worker threads with one task deque each
+// ... a worker pushes and pops its own tasks at the back (so nested tasks run depth-first and stay cache-warm)
+// ... and when it runs dry it steals from the front of the other deques (taking the oldest, usually largest, tasks)
+//
+// Tasks are grouped in TaskGroups, and wait() on a group keeps the calling thread running tasks until the group is done
+// ... (sleeping while there are none to take), so tasks may submit more tasks to the same group without deadlocking the pool
+
+class TaskGroup
+{
+    friend class ThreadPool;
+public:
+    TaskGroup() : _pending(0) {}
+    bool done() const { return _pending == 0; }
+private:
+    TaskGroup(const TaskGroup&);
+    std::atomic<int> _pending;
+};
+
+class ThreadPool
+{
+public:
+    ThreadPool(const int& nThreads = std::thread::hardware_concurrency());
+    ~ThreadPool();
+
+    int size() const { return _workers.size(); }
+
+    void submit(TaskGroup& group, const std::function<void()>& task);
+    void wait(TaskGroup& group);
+
+private:
+    ThreadPool(const ThreadPool&);
+
+    struct Task {
+        std::function<void()> run;
+        TaskGroup* group;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+    };
+
+    void work(const int& i);
+    bool runOne(const int& i);
+    bool pop(const int& i, Task& task);
+    bool steal(const int& i, Task& task);
+
+    std::vector<std::thread> _workers;
+    std::vector<Queue*> _queues;
+    std::atomic<int> _queued;
+    std::atomic<int> _nextQueue;     // round-robin target for tasks submitted from outside the pool
+    std::atomic<bool> _stop;
+
+    std::mutex _sleepMutex;
+    std::condition_variable _wake;
+};
+
+#endif
\ No newline at end of file
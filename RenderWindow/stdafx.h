@@ -17,6 +17,7 @@
 #include <fstream>
 #include <sstream>
 #include <vector>
+#include <array>
 #include <tuple>
 #include <unordered_map>
 #include <string>
@@ -26,6 +27,14 @@
 #include <set>
 #include <list>
 #include <queue>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <chrono>
+#include <random>
+#include <cassert>
 
 //#define _USE_MATH_DEFINES
 //#include <cmath>
@@ -35,6 +44,7 @@
 #include <GL/glut.h>
 #include <glm/glm.hpp>
 #include <glm/gtx/rotate_vector.hpp>
+#include <glm/gtc/quaternion.hpp>
 #include <armadillo>
 
 
@@ -200,4 +200,12 @@ void pushRotation(const AxisAngleRotation2& axisAngle) {
     float phi = axisAngle._axis[1];
     float angle = axisAngle._angle;
     glRotatef((180.0f / M_PI)*angle, sin(theta)*cos(phi), sin(theta)*sin(phi), cos(theta));
+}
+void pushRotation(const glm::mat3& R) {
+    GLfloat M[16] = {
+        R[0][0], R[0][1], R[0][2], 0,
+        R[1][0], R[1][1], R[1][2], 0,
+        R[2][0], R[2][1], R[2][2], 0,
+        0, 0, 0, 1 };
+    glMultMatrixf(M);
 }
\ No newline at end of file
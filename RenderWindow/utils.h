@@ -39,3 +39,4 @@ void printVector(const std::vector<float>&);
 void pushTranslation(const glm::vec3&);
 void pushRotation(const glm::vec3&);
 void pushRotation(const AxisAngleRotation2&);
+void pushRotation(const glm::mat3&);